@@ -0,0 +1,265 @@
+// Throughput of every conversion path of unic on each corpus profile
+
+#include "corpora.h"
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace
+{
+// Converts into buffers preallocated for the corpus, so only the conversion itself is timed.
+// No chunk decodes to more units than it has bytes.
+struct to_utf32_op
+{
+    ::std::u32string buffer;
+
+    explicit to_utf32_op(::std::size_t const bytes)
+        : buffer(bytes, U'\0')
+    {
+    }
+
+    void operator()(::std::u8string_view const text) { unic::to_utf32(text, buffer.data()); }
+};
+
+struct to_utf16_op
+{
+    ::std::u16string buffer;
+
+    explicit to_utf16_op(::std::size_t const bytes)
+        : buffer(bytes, u'\0')
+    {
+    }
+
+    void operator()(::std::u8string_view const text) { unic::to_utf16(text, buffer.data()); }
+};
+
+struct to_utf16_size_op
+{
+    void operator()(::std::u8string_view const text) { ::benchmark::DoNotOptimize(unic::to_utf16_size(text)); }
+};
+
+struct iterate_op
+{
+    void operator()(::std::u8string_view const text)
+    {
+        char32_t sum = 0;
+        for (char32_t const code_point : unic::from_utf8_range{text})
+            sum += code_point;
+        ::benchmark::DoNotOptimize(sum);
+    }
+};
+
+template <class op>
+void convert(::benchmark::State &state, corpora::profile const &profile)
+{
+    ::std::u8string_view const text = *profile.text;
+
+    ::std::vector<::std::u8string_view> chunks;
+    if (profile.by_line)
+    {
+        for (::std::size_t first = 0, last; first < text.size(); first = last + 1)
+        {
+            last = ::std::min(text.find(u8'\n', first), text.size());
+            chunks.push_back(text.substr(first, last - first));
+        }
+    }
+    else
+        chunks.push_back(text);
+
+    auto operation = [&] {
+        if constexpr (::std::is_constructible_v<op, ::std::size_t>)
+            return op(text.size());
+        else
+            return op{};
+    }();
+    ::std::uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        auto const start = corpora::read_cycles();
+        for (auto const chunk : chunks)
+        {
+            try
+            {
+                operation(chunk);
+            }
+            catch (unic::utf_error const &)
+            {
+            }
+        }
+        cycles += corpora::read_cycles() - start;
+        ::benchmark::ClobberMemory();
+    }
+    corpora::report(state, text.size(), cycles);
+}
+
+// The corpus decoded up front, so only the UTF-32 to UTF-16 kernel is timed
+void utf32_to_utf16(::benchmark::State &state, corpora::profile const &profile)
+{
+    ::std::u32string text;
+    unic::to_utf32(*profile.text, ::std::back_inserter(text));
+    ::std::u16string buffer(text.size() * 2, u'\0');
+
+    ::std::uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        auto const start = corpora::read_cycles();
+        unic::to_utf16(text, buffer.data());
+        cycles += corpora::read_cycles() - start;
+        ::benchmark::ClobberMemory();
+    }
+    corpora::report(state, text.size() * sizeof(char32_t), cycles);
+}
+
+// The corpus transcoded up front, so only the UTF-16 to UTF-32 kernel is timed
+void utf16_to_utf32(::benchmark::State &state, corpora::profile const &profile)
+{
+    ::std::u16string text;
+    unic::to_utf16(*profile.text, ::std::back_inserter(text));
+    ::std::u32string buffer(text.size(), U'\0');
+
+    ::std::uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        auto const start = corpora::read_cycles();
+        unic::to_utf32(text, buffer.data());
+        cycles += corpora::read_cycles() - start;
+        ::benchmark::ClobberMemory();
+    }
+    corpora::report(state, text.size() * sizeof(char16_t), cycles);
+}
+
+// Latin-1 and KOI8-R behind one interface, so every direction of both goes through single_byte
+struct latin1_charset
+{
+    static void from_utf8(::std::u8string_view const text, char *const out) { unic::latin1::from_utf8(text, out); }
+    static void to_utf8(::std::string_view const text, char8_t *const out) { unic::latin1::to_utf8(text, out); }
+    static void from_utf16(::std::u16string_view const text, char *const out) { unic::latin1::from_utf16(text, out); }
+    static void to_utf16(::std::string_view const text, char16_t *const out) { unic::latin1::to_utf16(text, out); }
+};
+
+// Against the table kernels
+struct koi8_r_charset
+{
+    static constexpr auto const &page = unic::code_pages::koi8_r;
+
+    static void from_utf8(::std::u8string_view const text, char *const out)
+    {
+        unic::code_pages::from_utf8(page, text, out);
+    }
+    static void to_utf8(::std::string_view const text, char8_t *const out)
+    {
+        unic::code_pages::to_utf8(page, text, out);
+    }
+    static void from_utf16(::std::u16string_view const text, char *const out)
+    {
+        unic::code_pages::from_utf16(page, text, out);
+    }
+    static void to_utf16(::std::string_view const text, char16_t *const out)
+    {
+        unic::code_pages::to_utf16(page, text, out);
+    }
+};
+
+// A corpus in a single-byte charset and in UTF-16, with room for the output of any direction
+struct single_byte_texts
+{
+    ::std::u8string_view utf8;
+    ::std::string text;
+    ::std::u16string utf16;
+
+    ::std::u8string utf8_out;
+    ::std::string text_out;
+    ::std::u16string utf16_out;
+
+    template <class charset>
+    single_byte_texts(charset const set, ::std::u8string_view const corpus)
+        : utf8(corpus)
+        , text(static_cast<::std::size_t>(unic::count_code_points(corpus)), '\0')
+        , utf16(text.size(), u'\0')
+        , utf8_out(corpus.size(), u8'\0')
+        , text_out(text.size(), '\0')
+        , utf16_out(text.size(), u'\0')
+    {
+        set.from_utf8(utf8, text.data());
+        set.to_utf16(text, utf16.data());
+    }
+};
+
+// Each direction of a charset; they return the units they read
+constexpr auto to_utf8 = [](auto const charset, single_byte_texts &texts) {
+    charset.to_utf8(texts.text, texts.utf8_out.data());
+    return texts.text.size();
+};
+constexpr auto from_utf8 = [](auto const charset, single_byte_texts &texts) {
+    charset.from_utf8(texts.utf8, texts.text_out.data());
+    return texts.utf8.size();
+};
+constexpr auto to_utf16 = [](auto const charset, single_byte_texts &texts) {
+    charset.to_utf16(texts.text, texts.utf16_out.data());
+    return texts.text.size();
+};
+constexpr auto from_utf16 = [](auto const charset, single_byte_texts &texts) {
+    charset.from_utf16(texts.utf16, texts.text_out.data());
+    return texts.utf16.size();
+};
+
+// The corpus converted to the charset and to UTF-16 up front, so only the conversion is timed
+template <class charset, class conversion>
+void single_byte(::benchmark::State &state, ::std::u8string const *const corpus, conversion const convert)
+{
+    single_byte_texts texts(charset{}, *corpus);
+    ::std::size_t units = 0;
+    ::std::uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        auto const start = corpora::read_cycles();
+        units = convert(charset{}, texts);
+        cycles += corpora::read_cycles() - start;
+        ::benchmark::ClobberMemory();
+    }
+    corpora::report(state, units, cycles);
+}
+
+template <class charset>
+void register_single_byte(::std::string const &name, ::std::u8string const &corpus)
+{
+    ::benchmark::RegisterBenchmark((name + "_to_utf8").c_str(), single_byte<charset, decltype(to_utf8)>, &corpus,
+                                   to_utf8);
+    ::benchmark::RegisterBenchmark(("utf8_to_" + name).c_str(), single_byte<charset, decltype(from_utf8)>, &corpus,
+                                   from_utf8);
+    ::benchmark::RegisterBenchmark((name + "_to_utf16").c_str(), single_byte<charset, decltype(to_utf16)>, &corpus,
+                                   to_utf16);
+    ::benchmark::RegisterBenchmark(("utf16_to_" + name).c_str(), single_byte<charset, decltype(from_utf16)>,
+                                   &corpus, from_utf16);
+}
+
+template <class op>
+void register_all(char const *const name)
+{
+    for (auto const &profile : corpora::profiles)
+        ::benchmark::RegisterBenchmark((::std::string(name) + '/' + profile.name).c_str(), convert<op>, profile);
+}
+
+bool const registered = [] {
+    register_all<to_utf32_op>("to_utf32");
+    register_all<to_utf16_op>("to_utf16");
+    register_all<to_utf16_size_op>("to_utf16_size");
+    register_all<iterate_op>("from_utf8_range");
+
+    register_single_byte<latin1_charset>("latin1", corpora::latin1);
+    register_single_byte<koi8_r_charset>("koi8_r", corpora::cyrillic);
+
+    for (auto const &profile : corpora::profiles)
+    {
+        if (!profile.by_line)
+        {
+            ::benchmark::RegisterBenchmark((::std::string("utf32_to_utf16/") + profile.name).c_str(), utf32_to_utf16,
+                                           profile);
+            ::benchmark::RegisterBenchmark((::std::string("utf16_to_utf32/") + profile.name).c_str(), utf16_to_utf32,
+                                           profile);
+        }
+    }
+    return true;
+}();
+} // namespace
@@ -0,0 +1,116 @@
+// Corpora shared by the benchmarks, ~1MiB each and the same on every run and standard library
+#pragma once
+
+#include "../unic.h"
+#include "generator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define UNIC_BENCH_TSC 1
+#elif defined(_M_X64)
+#include <intrin.h>
+#define UNIC_BENCH_TSC 1
+#else
+#define UNIC_BENCH_TSC 0
+#endif
+
+namespace corpora
+{
+inline constexpr ::std::size_t corpus_size = 1u << 20;
+
+// Builds the text by picking words from the given pool at random.
+// Mixing scripts word by word is what makes the header-length branch unpredictable.
+inline auto make_text(::std::vector<::std::u8string_view> const &words, unsigned const seed = 42) -> ::std::u8string
+{
+    splitmix64 gen(seed);
+
+    ::std::u8string text;
+    while (text.size() < corpus_size)
+    {
+        text += words[gen.below(words.size())];
+        text += u8' ';
+    }
+    return text;
+}
+
+// Mixed text in lines of ~80 bytes, one line in 16 carrying a random byte in place of a valid one
+inline auto make_invalid() -> ::std::u8string
+{
+    auto text = make_text({u8"hello", u8"привет", u8"world", u8"мир", u8"中文", u8"😀", u8"déjà"}, 7);
+
+    splitmix64 gen(7);
+    for (::std::size_t line = 80; line < text.size(); line += 80)
+    {
+        text[line] = u8'\n';
+        if (gen.below(16) == 0)
+            text[line - 40] = static_cast<char8_t>(0x80 + gen.below(0x80));
+    }
+    return text;
+}
+
+inline auto const ascii = make_text({u8"hello", u8"world", u8"unicode", u8"decoder", u8"branch"});
+inline auto const latin1 = make_text({u8"déjà", u8"café", u8"Straße", u8"naïve", u8"über", u8"año", u8"garçon"});
+inline auto const cyrillic = make_text({u8"привет", u8"мир", u8"юникод", u8"декодер", u8"ветвление"});
+inline auto const mixed = make_text({u8"hello", u8"привет", u8"world", u8"мир", u8"中文", u8"😀", u8"déjà"});
+inline auto const cjk = make_text({u8"中文", u8"日本語", u8"한국어", u8"汉字"});
+inline auto const emoji = make_text({u8"😀", u8"🚀🔥", u8"👍", u8"🎉🎉"});
+inline auto const invalid = make_invalid();
+
+struct profile
+{
+    char const *name;
+    ::std::u8string const *text;
+    bool by_line; // convert line by line, skipping the lines that throw
+};
+
+// A corpus from unic_corpus_gen or captured traffic, named by UNIC_BENCH_CORPUS
+inline auto const file = [] {
+    ::std::u8string text;
+    if (auto const path = ::std::getenv("UNIC_BENCH_CORPUS"))
+    {
+        ::std::ifstream in(path, ::std::ios::binary);
+        for (::std::istreambuf_iterator<char> it(in), end; it != end; ++it)
+            text += static_cast<char8_t>(*it);
+    }
+    return text;
+}();
+
+inline ::std::vector<profile> const profiles = [] {
+    ::std::vector<profile> all = {
+        {"ascii", &ascii, false},   {"latin1", &latin1, false}, {"cyrillic", &cyrillic, false}, {"cjk", &cjk, false},
+        {"emoji", &emoji, false},   {"mixed", &mixed, false},   {"invalid", &invalid, true},
+    };
+    if (!file.empty())
+        all.push_back({"file", &file, true});
+    return all;
+}();
+
+inline auto read_cycles() noexcept -> ::std::uint64_t
+{
+#if UNIC_BENCH_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Throughput counters: GB/s (decimal) and, where a cycle counter exists, TSC cycles per input byte
+inline void report(::benchmark::State &state, ::std::size_t const bytes, ::std::uint64_t const cycles)
+{
+    auto const total = static_cast<double>(state.iterations()) * static_cast<double>(bytes);
+    state.SetBytesProcessed(static_cast<::std::int64_t>(total));
+    state.counters["GB"] = ::benchmark::Counter(total / 1e9, ::benchmark::Counter::kIsRate);
+    if (UNIC_BENCH_TSC)
+        state.counters["cycles/byte"] = static_cast<double>(cycles) / total;
+}
+} // namespace corpora
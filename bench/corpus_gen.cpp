@@ -0,0 +1,99 @@
+// Writes a synthetic UTF-8 corpus, see generator.h
+// Usage: unic_corpus_gen [--size bytes] [--seed n] [--mix script=weight,...] [--lengths p1,p2,p3,p4]
+//                        [--run mean] [--errors rate] [-o file]
+// Scripts: ascii digits latin1 greek cyrillic arabic cjk hangul kana emoji cjk_ext_b
+
+#include "generator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+namespace
+{
+auto split(::std::string_view list) -> ::std::vector<::std::string>
+{
+    ::std::vector<::std::string> items;
+    while (!list.empty())
+    {
+        auto const comma = list.find(',');
+        items.emplace_back(list.substr(0, comma));
+        list = comma == list.npos ? ::std::string_view{} : list.substr(comma + 1);
+    }
+    return items;
+}
+
+auto parse_mix(::std::string_view const list) -> ::std::vector<::std::pair<::std::string, double>>
+{
+    ::std::vector<::std::pair<::std::string, double>> mix;
+    for (auto const &item : split(list))
+    {
+        auto const equals = item.find('=');
+        if (equals == item.npos)
+            mix.emplace_back(item, 1.0);
+        else
+            mix.emplace_back(item.substr(0, equals), ::std::stod(item.substr(equals + 1)));
+    }
+    return mix;
+}
+
+auto parse_lengths(::std::string_view const list) -> ::std::array<double, 4>
+{
+    auto const items = split(list);
+    if (items.size() != 4)
+        throw ::std::invalid_argument("--lengths takes four ratios");
+
+    ::std::array<double, 4> lengths{};
+    for (::std::size_t i = 0; i < 4; ++i)
+        lengths[i] = ::std::stod(items[i]);
+    return lengths;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    corpora::generator_spec spec;
+    char const *output = nullptr;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            ::std::string_view const option = argv[i];
+            if (i + 1 == argc)
+                throw ::std::invalid_argument("Missing value for " + ::std::string(option));
+            ::std::string const value = argv[++i];
+
+            if (option == "--size")
+                spec.size = ::std::stoull(value);
+            else if (option == "--seed")
+                spec.seed = ::std::stoull(value);
+            else if (option == "--mix")
+                spec.mix = parse_mix(value);
+            else if (option == "--lengths")
+                spec.lengths = parse_lengths(value);
+            else if (option == "--run")
+                spec.mean_run = ::std::stod(value);
+            else if (option == "--errors")
+                spec.error_rate = ::std::stod(value);
+            else if (option == "-o")
+                output = argv[i];
+            else
+                throw ::std::invalid_argument("Unknown option " + ::std::string(option));
+        }
+
+        auto const text = corpora::generate(spec);
+
+        auto const file = output ? ::std::fopen(output, "wb") : stdout;
+        if (!file || ::std::fwrite(text.data(), 1, text.size(), file) != text.size())
+            throw ::std::runtime_error("Can't write the corpus");
+        if (output)
+            ::std::fclose(file);
+    }
+    catch (::std::exception const &error)
+    {
+        ::std::fprintf(stderr, "unic_corpus_gen: %s\n", error.what());
+        return EXIT_FAILURE;
+    }
+}
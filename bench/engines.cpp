@@ -0,0 +1,64 @@
+// Branchy vs DFA decoding engine, iterating unic::from_utf8_range and in the bulk to_utf32
+
+#include "corpora.h"
+
+namespace
+{
+template <class engine>
+void decode(::benchmark::State &state, ::std::u8string const &text)
+{
+    ::std::uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        auto const start = corpora::read_cycles();
+        char32_t sum = 0;
+        for (char32_t const code_point : unic::from_utf8_range{text, engine{}})
+            sum += code_point;
+        ::benchmark::DoNotOptimize(sum);
+        cycles += corpora::read_cycles() - start;
+    }
+    corpora::report(state, text.size(), cycles);
+}
+
+template <class engine>
+void bulk(::benchmark::State &state, ::std::u8string const &text)
+{
+    ::std::u32string buffer(text.size(), U'\0');
+    ::std::uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        auto const start = corpora::read_cycles();
+        unic::to_utf32(text, buffer.data(), engine{});
+        cycles += corpora::read_cycles() - start;
+        ::benchmark::ClobberMemory();
+    }
+    corpora::report(state, text.size(), cycles);
+}
+} // namespace
+
+auto const branchy = decode<unic::engines::branchy>;
+auto const dfa = decode<unic::engines::dfa>;
+auto const bulk_branchy = bulk<unic::engines::branchy>;
+auto const bulk_dfa = bulk<unic::engines::dfa>;
+
+BENCHMARK_CAPTURE(branchy, ascii, corpora::ascii);
+BENCHMARK_CAPTURE(dfa, ascii, corpora::ascii);
+BENCHMARK_CAPTURE(branchy, cyrillic, corpora::cyrillic);
+BENCHMARK_CAPTURE(dfa, cyrillic, corpora::cyrillic);
+BENCHMARK_CAPTURE(branchy, mixed, corpora::mixed);
+BENCHMARK_CAPTURE(dfa, mixed, corpora::mixed);
+BENCHMARK_CAPTURE(branchy, cjk, corpora::cjk);
+BENCHMARK_CAPTURE(dfa, cjk, corpora::cjk);
+BENCHMARK_CAPTURE(branchy, emoji, corpora::emoji);
+BENCHMARK_CAPTURE(dfa, emoji, corpora::emoji);
+
+BENCHMARK_CAPTURE(bulk_branchy, ascii, corpora::ascii);
+BENCHMARK_CAPTURE(bulk_dfa, ascii, corpora::ascii);
+BENCHMARK_CAPTURE(bulk_branchy, cyrillic, corpora::cyrillic);
+BENCHMARK_CAPTURE(bulk_dfa, cyrillic, corpora::cyrillic);
+BENCHMARK_CAPTURE(bulk_branchy, mixed, corpora::mixed);
+BENCHMARK_CAPTURE(bulk_dfa, mixed, corpora::mixed);
+BENCHMARK_CAPTURE(bulk_branchy, cjk, corpora::cjk);
+BENCHMARK_CAPTURE(bulk_dfa, cjk, corpora::cjk);
+BENCHMARK_CAPTURE(bulk_branchy, emoji, corpora::emoji);
+BENCHMARK_CAPTURE(bulk_dfa, emoji, corpora::emoji);
@@ -0,0 +1,208 @@
+// Synthetic UTF-8 corpora with a chosen script mix, sequence length distribution, run lengths
+// and error rate. The output only depends on the spec: the random numbers come from a fixed
+// splitmix64 rather than <random>, whose distributions differ between standard libraries.
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace corpora
+{
+struct script
+{
+    ::std::string_view name;
+    char32_t first;
+    char32_t last;
+};
+
+// Grouped by encoded length, 1 to 4 bytes
+inline constexpr ::std::array scripts = {
+    script{"ascii", U'a', U'z'},
+    script{"digits", U'0', U'9'},
+    script{"latin1", U'\u00C0', U'\u00FF'},
+    script{"greek", U'\u03B1', U'\u03C9'},
+    script{"cyrillic", U'\u0430', U'\u044F'},
+    script{"arabic", U'\u0627', U'\u064A'},
+    script{"cjk", U'\u4E00', U'\u9FFF'},
+    script{"hangul", U'\uAC00', U'\uD7A3'},
+    script{"kana", U'\u3041', U'\u30FF'},
+    script{"emoji", U'\U0001F600', U'\U0001F64F'},
+    script{"cjk_ext_b", U'\U00020000', U'\U0002A6DF'},
+};
+
+struct generator_spec
+{
+    ::std::size_t size = 1u << 20; // bytes, the last run may overshoot by a few
+    ::std::uint64_t seed = 42;
+    ::std::vector<::std::pair<::std::string, double>> mix = {{"ascii", 1}};
+    ::std::array<double, 4> lengths{}; // share of 1/2/3/4 byte sequences, all zero to follow the mix only
+    double mean_run = 8;               // code points of one script between spaces
+    double error_rate = 0;             // chance of an invalid sequence in place of a code point
+};
+
+class splitmix64
+{
+  private:
+    ::std::uint64_t m_state;
+
+  public:
+    explicit splitmix64(::std::uint64_t const seed) noexcept
+        : m_state(seed)
+    {
+    }
+
+    auto next() noexcept -> ::std::uint64_t
+    {
+        auto z = (m_state += 0x9E3779B97F4A7C15u);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+        return z ^ (z >> 31);
+    }
+
+    // In [0, 1)
+    auto real() noexcept -> double { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    // In [0, bound)
+    auto below(::std::uint64_t const bound) noexcept -> ::std::uint64_t
+    {
+        return static_cast<::std::uint64_t>(real() * static_cast<double>(bound));
+    }
+};
+
+[[nodiscard]] constexpr auto encoded_length(char32_t const code_point) noexcept -> int
+{
+    return code_point < 0x80 ? 1 : code_point < 0x800 ? 2 : code_point < 0x10000 ? 3 : 4;
+}
+
+inline void append_utf8(::std::u8string &out, char32_t const c)
+{
+    switch (encoded_length(c))
+    {
+    case 1:
+        out += static_cast<char8_t>(c);
+        break;
+    case 2:
+        out += static_cast<char8_t>(0xC0 | (c >> 6));
+        out += static_cast<char8_t>(0x80 | (c & 0x3F));
+        break;
+    case 3:
+        out += static_cast<char8_t>(0xE0 | (c >> 12));
+        out += static_cast<char8_t>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char8_t>(0x80 | (c & 0x3F));
+        break;
+    default:
+        out += static_cast<char8_t>(0xF0 | (c >> 18));
+        out += static_cast<char8_t>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char8_t>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char8_t>(0x80 | (c & 0x3F));
+        break;
+    }
+}
+
+// One of the malformations a decoder has to reject
+inline void append_error(::std::u8string &out, splitmix64 &random)
+{
+    switch (random.below(5))
+    {
+    case 0: // stray trail byte
+        out += static_cast<char8_t>(0x80 | random.below(0x40));
+        break;
+    case 1: // sequence cut short
+        out += u8"\xE4\xB8";
+        break;
+    case 2: // overlong '/'
+        out += u8"\xC0\xAF";
+        break;
+    case 3: // encoded surrogate
+        out += u8"\xED\xA0\x80";
+        break;
+    default: // byte that never occurs in UTF-8
+        out += static_cast<char8_t>(0xF8 | random.below(8));
+        break;
+    }
+}
+
+[[nodiscard]] inline auto generate(generator_spec const &spec) -> ::std::u8string
+{
+    // Weight of each script: its share of the mix, rescaled to the length distribution if one is given
+    ::std::array<double, scripts.size()> weights{};
+    ::std::array<double, 4> class_total{};
+    for (auto const &[name, weight] : spec.mix)
+    {
+        auto found = false;
+        for (::std::size_t i = 0; i < scripts.size(); ++i)
+        {
+            if (scripts[i].name == name)
+            {
+                weights[i] += weight;
+                class_total[encoded_length(scripts[i].first) - 1] += weight;
+                found = true;
+            }
+        }
+        if (!found)
+            throw ::std::invalid_argument("Unknown script: " + name);
+    }
+
+    auto const by_length = spec.lengths != ::std::array<double, 4>{};
+    for (::std::size_t i = 0; i < scripts.size(); ++i)
+    {
+        auto const length = encoded_length(scripts[i].first) - 1;
+        if (by_length && weights[i] > 0)
+            weights[i] = spec.lengths[length] * weights[i] / class_total[length];
+    }
+    if (by_length)
+    {
+        for (int length = 0; length < 4; ++length)
+            if (spec.lengths[length] > 0 && class_total[length] == 0)
+                throw ::std::invalid_argument("No script in the mix encodes to " + ::std::to_string(length + 1) +
+                                              " bytes");
+    }
+
+    double total = 0;
+    for (auto const weight : weights)
+        total += weight;
+    if (!(total > 0))
+        throw ::std::invalid_argument("Empty script mix");
+
+    splitmix64 random(spec.seed);
+    auto const pick_script = [&] {
+        auto target = random.real() * total;
+        ::std::size_t i = 0;
+        for (; i + 1 < scripts.size(); ++i)
+        {
+            if (target < weights[i])
+                break;
+            target -= weights[i];
+        }
+        while (weights[i] == 0) // rounding past the last weighted script
+            --i;
+        return scripts[i];
+    };
+
+    ::std::u8string text;
+    text.reserve(spec.size + 8);
+    while (text.size() < spec.size)
+    {
+        auto const &current = pick_script();
+        auto const span = static_cast<::std::uint64_t>(current.last - current.first) + 1;
+
+        // Geometric run lengths with the requested mean
+        auto const stop = spec.mean_run > 1 ? 1 / spec.mean_run : 1;
+        do
+        {
+            if (spec.error_rate > 0 && random.real() < spec.error_rate)
+                append_error(text, random);
+            else
+                append_utf8(text, current.first + static_cast<char32_t>(random.below(span)));
+        } while (random.real() >= stop && text.size() < spec.size);
+
+        text += u8' ';
+    }
+    return text;
+}
+} // namespace corpora
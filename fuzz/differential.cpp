@@ -0,0 +1,509 @@
+// Differential fuzzer: every decoding, sizing and encoding path of unic has to agree with a scalar
+// from_utf8_range walk over a std::list, bounds checked on every byte - outputs, consumed counts and error offsets.
+// Builds as a libFuzzer target with Clang, or with driver.cpp where libFuzzer isn't available.
+
+#include "../unic.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+struct outcome
+{
+    ::std::u32string code_points;
+    ::std::ptrdiff_t error = -1; // byte offset, -1 when the input decoded
+    ::std::string message;
+
+    [[nodiscard]] auto operator==(outcome const &) const -> bool = default;
+};
+
+void check(bool const condition, char const *const what)
+{
+    if (!condition)
+    {
+        ::std::fprintf(stderr, "unic differential mismatch: %s\n", what);
+        ::std::abort();
+    }
+}
+
+// Runs the decode, recording the error it ends with
+template <class decode>
+auto record(::std::u8string_view const bytes, decode const &run) -> outcome
+{
+    outcome result;
+    try
+    {
+        run(result.code_points);
+    }
+    catch (unic::utf_positioned_error<char8_t const *> const &error)
+    {
+        result.error = error.error_position - bytes.data();
+        result.message = error.what();
+    }
+    catch (unic::utf_positioned_error<::std::ptrdiff_t> const &error)
+    {
+        result.error = error.error_position;
+        result.message = error.what();
+    }
+    return result;
+}
+
+// The reference: one sequence at a time over a std::list. Its iterators aren't contiguous or sized,
+// so the engine takes its generic path and compares against the end on every byte; none of the
+// pointer kernels or safe-zone code under test is involved.
+template <class engine>
+auto reference(::std::u8string_view const bytes) -> outcome
+{
+    ::std::list<char8_t> const source(bytes.begin(), bytes.end());
+    outcome result;
+    try
+    {
+        for (char32_t const code_point : unic::from_utf8_range{source.begin(), source.end(), engine{}})
+            result.code_points += code_point;
+    }
+    catch (unic::utf_positioned_error<::std::list<char8_t>::const_iterator> const &error)
+    {
+        result.error = ::std::distance(source.begin(), error.error_position);
+        result.message = error.what();
+    }
+    return result;
+}
+
+// For the paths that return nothing when they throw: the same error, or the same code points
+auto agrees(outcome const &actual, outcome const &expected) -> bool
+{
+    if (expected.error >= 0)
+        return actual.error == expected.error && actual.message == expected.message;
+    return actual == expected;
+}
+
+// What a UTF-16 conversion of the reference has to give, its error message or its units
+auto expected_utf16(outcome const &decoded, ::std::u16string &units) -> ::std::string
+{
+    for (auto const code_point : decoded.code_points)
+    {
+        if (code_point > 0x10FFFF)
+            return "Out of UTF-16 range";
+        if (code_point > 0xFFFF)
+        {
+            units += static_cast<char16_t>(((code_point - 0x10000) >> 10) + 0xD800);
+            units += static_cast<char16_t>(((code_point - 0x10000) & 0x3FF) + 0xDC00);
+        }
+        else
+            units += static_cast<char16_t>(code_point);
+    }
+    return decoded.message;
+}
+
+void check_decoders(::std::u8string_view const bytes, outcome const &expected)
+{
+    // bulk kernel: ASCII words, 2 and 3 byte blocks, engine for the rest
+    check(record(bytes, [&](::std::u32string &out) { unic::to_utf32(bytes, ::std::back_inserter(out)); }) ==
+              expected,
+          "to_utf32 (bulk kernel)");
+
+    unic::conversion_profile profile;
+    check(record(bytes,
+                 [&](::std::u32string &out) { unic::to_utf32(bytes, ::std::back_inserter(out), profile); }) ==
+              expected,
+          "to_utf32 (profiled)");
+    check(profile.errors == (expected.error >= 0), "conversion_profile errors");
+
+    // sized by counting lead bytes
+    check(agrees(record(bytes,
+                        [&](::std::u32string &out) {
+                            auto const result = unic::to_u32string(bytes);
+                            out.assign(result.begin(), result.end());
+                        }),
+                 expected),
+          "to_u32string");
+
+    // single-pass source, decoded through the lookahead buffer
+    check(record(bytes,
+                 [&](::std::u32string &out) {
+                     ::std::istringstream in(::std::string(bytes.begin(), bytes.end()));
+                     unic::to_utf32(::std::istreambuf_iterator<char>{in}, ::std::istreambuf_iterator<char>{},
+                                    ::std::back_inserter(out));
+                 }) == expected,
+          "from_utf8_input_range");
+
+    // backwards over a valid input
+    if (expected.error < 0)
+    {
+        ::std::u32string backwards;
+        auto const range = unic::from_utf8_range{bytes};
+        for (auto it = range.end(); it != range.begin();)
+            backwards += *--it;
+        check(::std::u32string(backwards.rbegin(), backwards.rend()) == expected.code_points, "reverse iteration");
+    }
+
+    // validating count, whole ASCII words skipped. It steps with the engine's next, which the branchy
+    // engine does by lead bytes only, so the reference is a walk of next rather than a decode.
+    auto const stepping = [&]<class engine>(engine) {
+        return [=](::std::u32string &out) {
+            auto const last = bytes.data() + bytes.size();
+            for (auto pos = bytes.data(); pos != last; pos = engine::next(pos, last))
+                out += U'\0';
+        };
+    };
+    auto const counting = [&](auto const engine) {
+        return [=](::std::u32string &out) {
+            out.resize(static_cast<::std::size_t>(unic::count_code_points(bytes, engine)));
+        };
+    };
+    check(agrees(record(bytes, counting(unic::engines::branchy{})), record(bytes, stepping(unic::engines::branchy{}))),
+          "count_code_points (branchy)");
+    check(agrees(record(bytes, counting(unic::engines::dfa{})), record(bytes, stepping(unic::engines::dfa{}))),
+          "count_code_points (dfa)");
+}
+
+void check_dfa(::std::u8string_view const bytes)
+{
+    auto const expected = reference<unic::engines::dfa>(bytes);
+
+    check(record(bytes,
+                 [&](::std::u32string &out) {
+                     ::std::istringstream in(::std::string(bytes.begin(), bytes.end()));
+                     for (auto const code_point : unic::from_utf8_input_range{::std::istreambuf_iterator<char>{in},
+                                                                              ::std::istreambuf_iterator<char>{},
+                                                                              unic::engines::dfa{}})
+                         out += code_point;
+                 }) == expected,
+          "from_utf8_input_range (dfa)");
+
+    // the streaming automaton of the bulk conversion
+    check(record(bytes,
+                 [&](::std::u32string &out) {
+                     unic::to_utf32(bytes, ::std::back_inserter(out), unic::engines::dfa{});
+                 }) == expected,
+          "to_utf32 (dfa)");
+
+    // the strict engine only accepts shortest forms, which the encoders have to reproduce byte for byte
+    if (expected.error < 0)
+    {
+        ::std::u8string encoded;
+        for (auto const unit : expected.code_points | unic::views::encode_utf8)
+            encoded += unit;
+        check(encoded == bytes, "encode_utf8 round trip");
+
+        ::std::u16string via_view;
+        for (auto const unit : bytes | unic::views::decode_utf8 | unic::views::encode_utf16)
+            via_view += unit;
+        ::std::u16string direct;
+        unic::to_utf16(bytes, ::std::back_inserter(direct));
+        check(via_view == direct, "decode_utf8 | encode_utf16");
+    }
+}
+
+void check_utf16(::std::u8string_view const bytes, outcome const &decoded)
+{
+    ::std::u16string expected;
+    auto const message = expected_utf16(decoded, expected);
+
+    ::std::u16string units;
+    ::std::string error;
+    try
+    {
+        unic::to_utf16(bytes, ::std::back_inserter(units));
+    }
+    catch (unic::utf_error const &e)
+    {
+        error = e.what();
+    }
+    check(error == message && (!error.empty() || units == expected), "to_utf16");
+
+    if (message.empty())
+    {
+        check(unic::to_utf16_size(bytes) == static_cast<::std::ptrdiff_t>(expected.size()), "to_utf16_size");
+        check(::std::u16string_view(unic::to_u16string(bytes)) == expected, "to_u16string");
+    }
+
+    // from the decoded code points, through the UTF-32 block kernel; the invalid ones are past U+10FFFF
+    auto const &code_points = decoded.code_points;
+    ::std::u16string encoded(code_points.size() * 2, u'\0');
+    ::std::ptrdiff_t failed_at = -1;
+    try
+    {
+        unic::to_utf16(code_points, encoded.data());
+    }
+    catch (unic::utf_positioned_error<::std::u32string::const_iterator> const &e)
+    {
+        failed_at = e.error_position - code_points.begin();
+    }
+
+    ::std::ptrdiff_t first_invalid = -1;
+    for (::std::size_t i = 0; i < code_points.size() && first_invalid < 0; ++i)
+        if (code_points[i] > 0x10FFFF)
+            first_invalid = static_cast<::std::ptrdiff_t>(i);
+    check(failed_at == first_invalid, "to_utf16 (UTF-32) error offset");
+    if (first_invalid < 0)
+    {
+        ::std::u16string direct;
+        expected_utf16(decoded, direct);
+        check(encoded.compare(0, direct.size(), direct) == 0, "to_utf16 (UTF-32)");
+        check(unic::to_utf16_size(code_points) == static_cast<::std::ptrdiff_t>(direct.size()),
+              "to_utf16_size (UTF-32)");
+    }
+}
+
+void check_counting(::std::u8string_view const bytes, outcome const &decoded)
+{
+    ::std::ptrdiff_t leads = 0;
+    for (auto const byte : bytes)
+        leads += (byte & 0xC0) != 0x80;
+    check(unic::count_code_points(bytes) == leads, "count_code_points (SWAR/SSE2)");
+
+    // The cuts are exact on valid text only, so they run on a valid text made of the decoded scalar
+    // values, and are checked against the sequence ends and UTF-16 sizes a forward decode finds
+    ::std::u32string scalars;
+    for (auto const code_point : decoded.code_points)
+    {
+        if (code_point <= 0x10FFFF && (code_point < 0xD800 || 0xDFFF < code_point))
+            scalars += code_point;
+    }
+    ::std::u8string text;
+    for (auto const unit : scalars | unic::views::encode_utf8)
+        text += unit;
+
+    ::std::vector<::std::ptrdiff_t> ends{0};
+    ::std::vector<::std::ptrdiff_t> units{0};
+    auto const range = unic::from_utf8_range{text};
+    for (auto it = range.begin(); it != range.end();)
+    {
+        auto const code_point = *it;
+        ++it;
+        ends.push_back(it.base() - text.data());
+        units.push_back(units.back() + (code_point > 0xFFFF ? 2 : 1));
+    }
+
+    for (::std::ptrdiff_t max = 0; max <= static_cast<::std::ptrdiff_t>(text.size()) + 1; max += 1 + max / 4)
+    {
+        // the last boundary within max bytes, and the last within max units
+        auto const by_bytes = ::std::ranges::upper_bound(ends, max) - ends.begin() - 1;
+        auto const by_units = ::std::ranges::upper_bound(units, max) - units.begin() - 1;
+        check(unic::truncate_utf8(text, max).size() == static_cast<::std::size_t>(ends[by_bytes]), "truncate_utf8");
+        check(unic::utf16_prefix_fitting(text, max).size() == static_cast<::std::size_t>(ends[by_units]),
+              "utf16_prefix_fitting");
+    }
+}
+
+// The same bytes taken as UTF-16 units: the block kernel against a from_utf16_range walk
+void check_utf16_decoding(::std::u8string_view const bytes)
+{
+    ::std::u16string units(bytes.size() / 2, u'\0');
+    ::std::memcpy(units.data(), bytes.data(), units.size() * sizeof(char16_t));
+
+    auto const walk = [&](::std::u32string &out) -> ::std::ptrdiff_t {
+        try
+        {
+            auto const range = unic::from_utf16_range{units.data(), units.data() + units.size()};
+            for (auto it = range.begin(); it != range.end(); ++it)
+                out += *it;
+        }
+        catch (unic::utf_positioned_error<char16_t *> const &error)
+        {
+            return error.error_position - units.data();
+        }
+        return -1;
+    };
+    auto const bulk = [&](auto const out) -> ::std::ptrdiff_t {
+        try
+        {
+            unic::to_utf32(::std::u16string_view(units), out);
+        }
+        catch (unic::utf_positioned_error<char16_t const *> const &error)
+        {
+            return error.error_position - units.data();
+        }
+        return -1;
+    };
+
+    ::std::u32string expected;
+    auto const error = walk(expected);
+
+    ::std::u32string buffer(units.size(), U'\0');
+    check(bulk(buffer.data()) == error, "to_utf32 (UTF-16) error offset");
+    check(buffer.compare(0, expected.size(), expected) == 0, "to_utf32 (UTF-16)");
+
+    ::std::u32string appended;
+    check(bulk(::std::back_inserter(appended)) == error && appended == expected, "to_utf32 (UTF-16, iterator)");
+
+    if (error < 0)
+        check(::std::u32string_view(unic::to_u32string(units)) == expected, "to_u32string (UTF-16)");
+}
+
+// Latin-1 and each code page behind one interface, so both go through check_single_byte
+struct latin1_charset
+{
+    char const *name = "latin1";
+    char const *unmapped = "Out of Latin-1 range";
+
+    auto decode(char const byte) const -> char32_t { return static_cast<unsigned char>(byte); }
+    auto encode(char32_t const code_point) const -> int
+    {
+        return code_point <= 0xFF ? static_cast<int>(code_point) : -1;
+    }
+    auto to_utf8_size(::std::string_view const text) const { return unic::latin1::to_utf8_size(text); }
+    void to_utf8(::std::string_view const text, char8_t *const out) const { unic::latin1::to_utf8(text, out); }
+    void to_utf16(::std::string_view const text, char16_t *const out) const { unic::latin1::to_utf16(text, out); }
+    void from_utf8(::std::u8string_view const text, char *const out) const { unic::latin1::from_utf8(text, out); }
+    void from_utf16(::std::u16string_view const text, char *const out) const { unic::latin1::from_utf16(text, out); }
+};
+
+struct code_page_charset
+{
+    unic::code_pages::code_page const &page;
+    char const *name = "code_pages";
+    char const *unmapped = "Not in the code page";
+
+    auto decode(char const byte) const -> char32_t { return page.decode(byte); }
+    auto encode(char32_t const code_point) const -> int { return page.encode(code_point); }
+    auto to_utf8_size(::std::string_view const text) const { return unic::code_pages::to_utf8_size(page, text); }
+    void to_utf8(::std::string_view const text, char8_t *const out) const
+    {
+        unic::code_pages::to_utf8(page, text, out);
+    }
+    void to_utf16(::std::string_view const text, char16_t *const out) const
+    {
+        unic::code_pages::to_utf16(page, text, out);
+    }
+    void from_utf8(::std::u8string_view const text, char *const out) const
+    {
+        unic::code_pages::from_utf8(page, text, out);
+    }
+    void from_utf16(::std::u16string_view const text, char *const out) const
+    {
+        unic::code_pages::from_utf16(page, text, out);
+    }
+};
+
+// The bytes taken in the charset through every kernel and back, then the UTF-8 input encoded into it
+template <class charset>
+void check_single_byte(::std::u8string_view const bytes, outcome const &decoded, charset const &set)
+{
+    auto const label = [&](char const *const what) { return ::std::string(set.name) + "::" + what; };
+    ::std::string const text(bytes.begin(), bytes.end());
+
+    ::std::u32string widened;
+    for (char const byte : text)
+        widened += set.decode(byte);
+
+    ::std::u8string utf8(static_cast<::std::size_t>(set.to_utf8_size(text)), u8'\0');
+    set.to_utf8(text, utf8.data());
+    check(::std::u32string_view(unic::to_u32string(utf8)) == widened, label("to_utf8").c_str());
+
+    ::std::u16string units(text.size(), u'\0');
+    set.to_utf16(text, units.data());
+    check(::std::equal(units.begin(), units.end(), widened.begin()), label("to_utf16").c_str());
+
+    ::std::string narrowed(text.size(), '\0');
+    set.from_utf16(units, narrowed.data());
+    check(narrowed == text, label("from_utf16 round trip").c_str());
+    narrowed.assign(text.size(), '\0');
+    set.from_utf8(utf8, narrowed.data());
+    check(narrowed == text, label("from_utf8 round trip").c_str());
+
+    // straight from the input: what to_utf32 decodes, or its error when that comes before a code point the
+    // charset lacks
+    ::std::ptrdiff_t expected_error = decoded.error;
+    ::std::string expected_message = decoded.message;
+    ::std::string expected_text;
+    auto pos = bytes.data();
+    for (auto const code_point : decoded.code_points)
+    {
+        auto const start = pos;
+        pos = unic::engines::branchy::next(pos, bytes.data() + bytes.size());
+        auto const byte = set.encode(code_point);
+        if (byte < 0)
+        {
+            expected_error = start - bytes.data();
+            expected_message = set.unmapped;
+            break;
+        }
+        expected_text += static_cast<char>(byte);
+    }
+
+    ::std::string actual(bytes.size(), '\0');
+    ::std::ptrdiff_t error = -1;
+    ::std::string message;
+    try
+    {
+        set.from_utf8(bytes, actual.data());
+    }
+    catch (unic::utf_positioned_error<char8_t const *> const &e)
+    {
+        error = e.error_position - bytes.data();
+        message = e.what();
+    }
+    check(error == expected_error && message == expected_message, label("from_utf8 error").c_str());
+    check(actual.compare(0, expected_text.size(), expected_text) == 0, label("from_utf8").c_str());
+}
+
+// A code page picked by the first byte, through the shared checks and the paths only code pages have
+void check_code_pages(::std::u8string_view const bytes, outcome const &decoded)
+{
+    static constexpr unic::code_pages::code_page const *pages[] = {
+        &unic::code_pages::windows_1250, &unic::code_pages::windows_1251, &unic::code_pages::windows_1252,
+        &unic::code_pages::koi8_r,       &unic::code_pages::koi8_u,       &unic::code_pages::iso_8859_2,
+        &unic::code_pages::iso_8859_5,   &unic::code_pages::iso_8859_15,
+    };
+    auto const &page = *pages[bytes.empty() ? 0 : bytes[0] % ::std::size(pages)];
+    check_single_byte(bytes, decoded, code_page_charset{page});
+
+    ::std::string const text(bytes.begin(), bytes.end());
+    ::std::u32string widened(text.size(), U'\0');
+    unic::code_pages::to_utf32(page, text, widened.data());
+    check(::std::equal(text.begin(), text.end(), widened.begin(),
+                       [&](char const c, char32_t const w) { return page.decode(c) == w; }),
+          "code_pages::to_utf32");
+
+    ::std::u8string appended;
+    unic::code_pages::to_utf8(page, text, ::std::back_inserter(appended));
+    check(::std::u32string_view(unic::to_u32string(appended)) == widened, "code_pages::to_utf8 (iterator)");
+    ::std::u8string viewed;
+    for (auto const unit : text | unic::views::decode_code_page(page) | unic::views::encode_utf8)
+        viewed += unit;
+    check(viewed == appended, "views::decode_code_page");
+}
+
+// Decoding of a null-terminated copy has to stop at the first zero byte. The aligned word kernel
+// is only compiled in without ASan, i.e. in unic_fuzz_overread.
+void check_null_terminated(::std::u8string_view const bytes)
+{
+    ::std::u8string const terminated(bytes);
+    auto const prefix = ::std::u8string_view(terminated.c_str());
+
+    auto const expected = reference<unic::engines::branchy>(prefix);
+    auto const actual = record(prefix, [&](::std::u32string &out) {
+        unic::to_utf32(terminated.c_str(), unic::null_terminator{}, ::std::back_inserter(out));
+    });
+    check(actual == expected, "to_utf32 (null-terminated)");
+}
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(::std::uint8_t const *const data, ::std::size_t const size)
+{
+    ::std::u8string const input(reinterpret_cast<char8_t const *>(data), size);
+    ::std::u8string_view const bytes = input;
+
+    auto const expected = reference<unic::engines::branchy>(bytes);
+    check_decoders(bytes, expected);
+    check_dfa(bytes);
+    check_utf16(bytes, expected);
+    check_counting(bytes, expected);
+    check_null_terminated(bytes);
+    check_utf16_decoding(bytes);
+    check_single_byte(bytes, expected, latin1_charset{});
+    check_code_pages(bytes, expected);
+    return 0;
+}
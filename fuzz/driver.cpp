@@ -0,0 +1,82 @@
+// Stand-in for libFuzzer: replays the files given on the command line, or with none, runs
+// generated inputs - valid text of every sequence length with random bytes spliced in.
+// Usage: unic_fuzz_differential [files...] | [--runs n] [--seed n]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(::std::uint8_t const *data, ::std::size_t size);
+
+namespace
+{
+auto next(::std::uint64_t &state) -> ::std::uint64_t
+{
+    auto z = (state += 0x9E3779B97F4A7C15u);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+    return z ^ (z >> 31);
+}
+
+auto generate(::std::uint64_t &state) -> ::std::vector<::std::uint8_t>
+{
+    static constexpr ::std::string_view pieces[] = {
+        "a", "hello world ", "\xD0\xBF", "\xD0\xBF\xD1\x80\xD0\xB8", "\xE4\xB8\xAD", "\xE4\xB8\xAD\xE6\x96\x87",
+        "\xF0\x9F\x98\x80", "\xC3\xA9", "\xC0\xAF", "\xED\xA0\x80", "\xE0\xA0\x80", "\xF4\x90\x80\x80",
+        "\xF8\x88\x80\x80\x80", "\xEF\xBF\xBF",
+    };
+
+    ::std::vector<::std::uint8_t> input;
+    auto const count = next(state) % 40;
+    for (::std::uint64_t i = 0; i < count; ++i)
+    {
+        auto const choice = next(state) % 32;
+        if (choice < ::std::size(pieces))
+            input.insert(input.end(), pieces[choice].begin(), pieces[choice].end());
+        else if (choice < 30)
+            input.insert(input.end(), pieces[0].begin(), pieces[0].end());
+        else
+            input.push_back(static_cast<::std::uint8_t>(next(state)));
+    }
+    return input;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::std::uint64_t runs = 100000;
+    ::std::uint64_t seed = 1;
+    ::std::vector<char const *> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        ::std::string_view const arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = ::std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = ::std::strtoull(argv[++i], nullptr, 10);
+        else
+            files.push_back(argv[i]);
+    }
+
+    for (auto const path : files)
+    {
+        ::std::ifstream in(path, ::std::ios::binary);
+        ::std::vector<::std::uint8_t> const input{::std::istreambuf_iterator<char>(in), {}};
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    if (files.empty())
+    {
+        for (::std::uint64_t run = 0; run < runs; ++run)
+        {
+            auto const input = generate(seed);
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+        }
+        ::std::printf("%llu inputs agreed\n", static_cast<unsigned long long>(runs));
+    }
+}
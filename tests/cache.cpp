@@ -0,0 +1,82 @@
+// transcode_cache, from unic_cache.h
+
+#include "../unic_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+
+namespace
+{
+using namespace ::std::string_view_literals;
+
+TEST(transcode_cache, hits_after_the_first_get)
+{
+    unic::transcode_cache cache{1 << 16};
+    EXPECT_EQ(cache.get(u8"field_name"sv).view(), u"field_name"sv);
+    EXPECT_EQ(cache.get(u8"жук \U0001F600"sv).view(), u"жук \U0001F600"sv);
+    EXPECT_EQ(cache.get(u8"field_name"sv).view(), u"field_name"sv);
+
+    auto const stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+}
+
+TEST(transcode_cache, handles_outlive_eviction)
+{
+    // room for about one entry per shard, so filling it evicts
+    unic::transcode_cache cache{unic::transcode_cache::min_budget + 16 * 64};
+    auto const pinned = cache.get(u8"pinned"sv);
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto const key = u8"key " + ::std::u8string(static_cast<::std::size_t>(i % 20), u8'x');
+        (void)cache.get(key);
+    }
+
+    EXPECT_GT(cache.stats().evictions, 0u);
+    EXPECT_EQ(pinned.view(), u"pinned"sv);
+}
+
+// min_budget leaves each shard entry_overhead bytes
+auto cached(::std::size_t const extra_per_shard, ::std::u8string_view const key) -> bool
+{
+    unic::transcode_cache cache{unic::transcode_cache::min_budget + 16 * extra_per_shard};
+    (void)cache.get(key);
+    (void)cache.get(key);
+    return cache.stats().hits == 1;
+}
+
+TEST(transcode_cache, charges_the_heap_blocks_of_its_strings)
+{
+    // short strings are held inside the entry, which entry_overhead already counts
+    EXPECT_TRUE(cached(0, u8"ab"sv));
+
+    // long ones for their capacity and terminator: 41 bytes of key, 41 units of value
+    auto const key = ::std::u8string(40, u8'k');
+    EXPECT_FALSE(cached(40 + 40 * 2, key));
+    EXPECT_TRUE(cached(41 + 41 * 2, key));
+}
+
+TEST(transcode_cache, budget_has_a_minimum)
+{
+#if UNIC_EXCEPTIONS
+    EXPECT_THROW(unic::transcode_cache{unic::transcode_cache::min_budget - 1}, ::std::invalid_argument);
+    EXPECT_NO_THROW(unic::transcode_cache{unic::transcode_cache::min_budget});
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(transcode_cache, invalid_keys_throw_and_are_not_cached)
+{
+#if UNIC_EXCEPTIONS
+    unic::transcode_cache cache{1 << 16};
+    EXPECT_THROW((void)cache.get(u8"\xFF"sv), unic::utf_error);
+    EXPECT_THROW((void)cache.get(u8"\xFF"sv), unic::utf_error);
+    EXPECT_EQ(cache.stats().hits, 0u);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+} // namespace
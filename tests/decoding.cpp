@@ -0,0 +1,416 @@
+// Decoding engines, iteration in both directions, the allocating conversions, the views and u16_literal
+
+#include "../unic.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+using namespace ::std::string_literals;
+using namespace ::std::string_view_literals;
+
+// One sequence of every length, long enough to take the bulk paths past their ASCII blocks
+::std::u8string const mixed = u8"plain ASCII text, then Cyrillic жук, CJK 中文 and "
+                              u8"an emoji \U0001F600 at the end of a line\n"s;
+
+template <class engine>
+auto decode(::std::u8string_view const text) -> ::std::u32string
+{
+    ::std::u32string result;
+    for (char32_t const code_point : unic::from_utf8_range{text, engine{}})
+        result.push_back(code_point);
+    return result;
+}
+
+template <class engine>
+auto bulk_utf32(::std::u8string_view const text) -> ::std::u32string
+{
+    ::std::u32string result(text.size(), U'\0');
+    unic::to_utf32(text, result.data(), engine{});
+    return result.substr(0, unic::count_code_points(text));
+}
+
+auto throws(auto const &convert) -> bool
+{
+#if UNIC_EXCEPTIONS
+    try
+    {
+        convert();
+    }
+    catch (unic::utf_error const &)
+    {
+        return true;
+    }
+#endif
+    return false;
+}
+
+TEST(engines, agree_on_valid_text)
+{
+    auto const expected = U"plain ASCII text, then Cyrillic жук, CJK 中文 and "
+                          U"an emoji \U0001F600 at the end of a line\n"s;
+
+    EXPECT_EQ(decode<unic::engines::branchy>(mixed), expected);
+    EXPECT_EQ(decode<unic::engines::dfa>(mixed), expected);
+    EXPECT_EQ(bulk_utf32<unic::engines::branchy>(mixed), expected);
+    EXPECT_EQ(bulk_utf32<unic::engines::dfa>(mixed), expected);
+    EXPECT_EQ(unic::count_code_points(mixed, unic::engines::dfa{}), static_cast<::std::ptrdiff_t>(expected.size()));
+}
+
+TEST(engines, dfa_rejects_what_branchy_accepts)
+{
+#if UNIC_EXCEPTIONS
+    for (auto const text : {u8"\xC0\x80"sv, u8"\xE0\x80\x80"sv, u8"\xED\xA0\x80"sv, u8"\xF4\x90\x80\x80"sv})
+    {
+        EXPECT_FALSE(throws([&] { (void)decode<unic::engines::branchy>(text); }));
+        EXPECT_TRUE(throws([&] { (void)decode<unic::engines::dfa>(text); }));
+        EXPECT_TRUE(throws([&] { (void)bulk_utf32<unic::engines::dfa>(text); }));
+    }
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(engines, dfa_stream_stays_within_count_code_points)
+{
+    // valid text: exactly its code points
+    ::std::u32string exact(static_cast<::std::size_t>(unic::count_code_points(mixed)), U'\0');
+    exact += U'!';
+    unic::to_utf32(mixed, exact.data(), unic::engines::dfa{});
+    EXPECT_EQ(exact.back(), U'!');
+    EXPECT_EQ(exact.substr(0, exact.size() - 1), decode<unic::engines::dfa>(mixed));
+
+#if UNIC_EXCEPTIONS
+    // invalid text: the unfinished sequence may take its lead's slot, nothing past it
+    for (auto const text : {u8"ab\xE2\x82"sv, u8"ab\xE2\x82x"sv, u8"ab\xF0\x9F\x98"sv})
+    {
+        ::std::u32string buffer(static_cast<::std::size_t>(unic::count_code_points(text)), U'\0');
+        buffer += U'!';
+        EXPECT_THROW(unic::to_utf32(text, buffer.data(), unic::engines::dfa{}), unic::utf_error);
+        EXPECT_EQ(buffer.substr(0, 2), U"ab");
+        EXPECT_EQ(buffer.back(), U'!');
+    }
+#endif
+}
+
+TEST(engines, report_the_error_position)
+{
+#if UNIC_EXCEPTIONS
+    auto const text = u8"valid \xE2\x82 then cut"sv;
+    for (auto const strict : {false, true})
+    {
+        try
+        {
+            if (strict)
+                (void)bulk_utf32<unic::engines::dfa>(text);
+            else
+                (void)bulk_utf32<unic::engines::branchy>(text);
+            ADD_FAILURE() << "no error";
+        }
+        catch (unic::utf_positioned_error<char8_t const *> const &error)
+        {
+            EXPECT_EQ(error.error_position - text.data(), 8);
+        }
+    }
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+// Offset of the error position, caught as the caller's iterator type
+template <class src_iter>
+auto error_offset(src_iter const first, auto const &convert) -> ::std::ptrdiff_t
+{
+#if UNIC_EXCEPTIONS
+    try
+    {
+        convert();
+    }
+    catch (unic::utf_positioned_error<src_iter> const &error)
+    {
+        return error.error_position - first;
+    }
+#endif
+    return -1;
+}
+
+// Offset and message of the error, caught as src_iter's error type
+template <class src_iter>
+auto error_at(src_iter const first, auto const &convert) -> ::std::pair<::std::ptrdiff_t, ::std::string>
+{
+#if UNIC_EXCEPTIONS
+    try
+    {
+        convert();
+    }
+    catch (unic::utf_positioned_error<src_iter> const &error)
+    {
+        return {error.error_position - first, error.what()};
+    }
+#endif
+    return {-1, ""};
+}
+
+TEST(errors, are_positioned_at_the_callers_iterator)
+{
+#if UNIC_EXCEPTIONS
+    ::std::vector<char32_t> const code_points{U'a', U'\U0001F600', U'b', 0x110000, U'c'};
+    EXPECT_EQ(error_offset(code_points.begin(), [&] { (void)unic::to_utf16_size(code_points); }), 3);
+    ::std::u16string encoded;
+    EXPECT_EQ(error_offset(code_points.begin(), [&] { unic::to_utf16(code_points, ::std::back_inserter(encoded)); }),
+              3);
+
+    ::std::u16string const units{u'a', 0xD83D, 0xDE00, u'b', 0xDC00, u'c'};
+    ::std::u32string decoded;
+    EXPECT_EQ(error_offset(units.begin(), [&] { unic::to_utf32(units, ::std::back_inserter(decoded)); }), 4);
+
+    ::std::u8string const bytes = u8"abc\xE2\x82 def"s; // the space is no trail byte
+    EXPECT_EQ(error_offset(bytes.begin(), [&] { (void)unic::to_utf16_size(bytes); }), 5);
+    ::std::u32string code_points_out;
+    EXPECT_EQ(error_offset(bytes.begin(), [&] { unic::to_utf32(bytes, ::std::back_inserter(code_points_out)); }), 5);
+    ::std::u16string units_out;
+    EXPECT_EQ(error_offset(bytes.begin(), [&] { unic::to_utf16(bytes, ::std::back_inserter(units_out)); }), 5);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(utf32_to_utf16, rejects_code_points_past_unicode)
+{
+#if UNIC_EXCEPTIONS
+    // one invalid code point in the scalar tail, one in a block of the kernel, one in the first unit
+    for (::std::size_t const at : {3u, 13u, 0u})
+    {
+        ::std::u32string code_points(20, U'a');
+        code_points[at] = 0x110000;
+        ::std::u32string_view const view = code_points;
+
+        ::std::u16string units(40, u'\0');
+        auto const [offset, message] = error_at(view.data(), [&] { unic::to_utf16(view, units.data()); });
+        EXPECT_EQ(offset, static_cast<::std::ptrdiff_t>(at));
+        EXPECT_EQ(message, "Out of UTF-16 range");
+        EXPECT_EQ(error_at(view.data(), [&] { (void)unic::to_utf16_size(view); }).first,
+                  static_cast<::std::ptrdiff_t>(at));
+    }
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(utf16_to_utf32, rejects_lone_surrogates)
+{
+#if UNIC_EXCEPTIONS
+    struct lone
+    {
+        ::std::size_t at;
+        char16_t unit;
+        char const *message;
+    };
+    // before, inside and after the first block of 8 units, and a high surrogate that ends the text
+    for (auto const [at, unit, message] : {lone{2, 0xDC00, "Unpaired low surrogate"},
+                                           lone{10, 0xD800, "Unpaired high surrogate"},
+                                           lone{17, 0xDFFF, "Unpaired low surrogate"},
+                                           lone{19, 0xDBFF, "Unpaired high surrogate"}})
+    {
+        ::std::u16string units(20, u'a');
+        units[at] = unit;
+        ::std::u16string_view const view = units;
+
+        ::std::u32string code_points(20, U'\0');
+        auto const error = error_at(view.data(), [&] { unic::to_utf32(view, code_points.data()); });
+        EXPECT_EQ(error.first, static_cast<::std::ptrdiff_t>(at));
+        EXPECT_EQ(error.second, message);
+    }
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(null_terminated, decodes_up_to_the_terminator)
+{
+    auto const expected = unic::to_u32string(mixed);
+    // every alignment of the start, so the word path meets the terminator at each byte of a word
+    for (::std::size_t shift = 0; shift < 8; ++shift)
+    {
+        ::std::u8string buffer(shift, u8'-');
+        buffer += mixed;
+        buffer += u8'\0';
+        buffer += u8"not decoded";
+
+        ::std::u32string code_points;
+        unic::to_utf32(buffer.c_str() + shift, unic::null_terminator{}, ::std::back_inserter(code_points));
+        EXPECT_EQ(code_points, ::std::u32string_view{expected});
+
+        ::std::u32string iterated;
+        for (char32_t const code_point : unic::from_utf8_range{buffer.c_str() + shift, unic::null_terminator{}})
+            iterated.push_back(code_point);
+        EXPECT_EQ(iterated, code_points);
+    }
+}
+
+#if __has_include(<sys/mman.h>)
+TEST(null_terminated, stops_at_a_terminator_before_an_unmapped_page)
+{
+    auto const page = static_cast<::std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto const memory = static_cast<char8_t *>(
+        ::mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(static_cast<void *>(memory), MAP_FAILED);
+    ASSERT_EQ(::mprotect(memory + page, page, PROT_NONE), 0);
+
+    // strings of every length up to 40 whose terminator is the last readable byte
+    for (::std::ptrdiff_t length = 0; length <= 40; ++length)
+    {
+        auto const text = unic::truncate_utf8(mixed, length);
+        auto const str = memory + page - 1 - text.size();
+        ::std::ranges::copy(text, str);
+        str[text.size()] = u8'\0';
+
+        ::std::u32string code_points;
+        unic::to_utf32(str, unic::null_terminator{}, ::std::back_inserter(code_points));
+        EXPECT_EQ(code_points, ::std::u32string_view{unic::to_u32string(text)});
+    }
+    ::munmap(memory, 2 * page);
+}
+#endif
+
+TEST(from_utf8_input_range, decodes_a_stream)
+{
+    ::std::istringstream stream{::std::string(mixed.begin(), mixed.end())};
+    unic::from_utf8_input_range range{::std::istreambuf_iterator<char>{stream}, ::std::istreambuf_iterator<char>{}};
+
+    ::std::u32string code_points;
+    for (char32_t const code_point : range)
+        code_points.push_back(code_point);
+    EXPECT_EQ(code_points, ::std::u32string_view{unic::to_u32string(mixed)});
+}
+
+TEST(from_utf8_input_range, reports_the_stream_offset_of_errors)
+{
+#if UNIC_EXCEPTIONS
+    // cut by the end of the stream, and an invalid trail byte past the first 8 bytes
+    for (auto const text : {u8"abc\xF0\x9F\x98"sv, u8"abcdefghij\xE2\x82 "sv, u8"\xE2"sv})
+    {
+        ::std::istringstream stream{::std::string(text.begin(), text.end())};
+        ::std::ptrdiff_t offset = -1;
+        ::std::string message;
+        try
+        {
+            ::std::u32string code_points;
+            unic::to_utf32(::std::istreambuf_iterator<char>{stream}, ::std::istreambuf_iterator<char>{},
+                           ::std::back_inserter(code_points));
+        }
+        catch (unic::utf_positioned_error<::std::ptrdiff_t> const &error)
+        {
+            offset = error.error_position;
+            message = error.what();
+        }
+
+        // where the contiguous decoder puts it
+        auto const expected = error_at(text.data(), [&] { (void)unic::to_u32string(text); });
+        EXPECT_EQ(offset, expected.first);
+        EXPECT_EQ(message, expected.second);
+        EXPECT_GE(offset, 0);
+    }
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(from_utf8_range, iterates_backwards)
+{
+    for (auto const text : {::std::u8string_view{mixed}, u8""sv, u8"\U0001F600"sv, u8"aж"sv})
+    {
+        auto const forward = decode<unic::engines::dfa>(text);
+
+        ::std::u32string backward;
+        for (char32_t const code_point : unic::from_utf8_range{text, unic::engines::dfa{}} | ::std::views::reverse)
+            backward.push_back(code_point);
+        ::std::ranges::reverse(backward);
+        EXPECT_EQ(backward, forward);
+    }
+
+    // stepping back from the end lands on the lead of the last sequence
+    auto const range = unic::from_utf8_range{mixed};
+    auto it = range.end();
+    --it;
+    EXPECT_EQ(*it, U'\n');
+    --it;
+    EXPECT_EQ(*it, U'e');
+    it = ::std::ranges::next(range.begin(), 32);
+    EXPECT_EQ(*it, U'ж');
+    --it;
+    EXPECT_EQ(*it, U' ');
+}
+
+TEST(from_utf8_range, begin_throws_on_an_invalid_first_sequence)
+{
+#if UNIC_EXCEPTIONS
+    auto const range = unic::from_utf8_range{u8"\xE2\x82"sv};
+    EXPECT_THROW((void)range.begin(), unic::utf_error);
+    EXPECT_THROW((void)range.cbegin(), unic::utf_error);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(allocating, overlong_forms_are_cut_to_what_decoded)
+{
+    // a lenient 4 byte overlong ASCII form is sized as a surrogate pair but decodes to one unit
+    auto const code_points = unic::to_u32string(u8"\xF0\x80\x81\x81"sv);
+    EXPECT_EQ(code_points, U"A");
+
+    auto const units = unic::to_u16string(u8"\xF0\x80\x81\x81 \xF0\x9F\x98\x80"sv);
+    EXPECT_EQ(units, ::std::u16string_view{u"A \U0001F600"});
+}
+
+TEST(allocating, round_trip)
+{
+    auto const units = unic::to_u16string(mixed);
+    EXPECT_EQ(unic::to_u32string(units), unic::to_u32string(mixed));
+    EXPECT_EQ(units.size(), static_cast<::std::size_t>(unic::to_utf16_size(unic::from_utf8_range{mixed})));
+}
+
+TEST(views, fused_and_unfused_pipelines_agree)
+{
+    auto const units = unic::to_u16string(mixed);
+
+    // the encoder reads the UTF-8 source itself when stacked on the decoder
+    auto const fused = mixed | unic::views::decode_utf8 | unic::views::encode_utf16;
+    EXPECT_TRUE(::std::ranges::equal(fused, units));
+
+    auto const strict = mixed | unic::views::decode_utf8(unic::engines::dfa{}) | unic::views::encode_utf16;
+    EXPECT_TRUE(::std::ranges::equal(strict, units));
+
+    // a plain code point range goes through the generic reader
+    auto const code_points = unic::to_u32string(mixed);
+    EXPECT_TRUE(::std::ranges::equal(code_points | unic::views::encode_utf16, units));
+    EXPECT_TRUE(::std::ranges::equal(code_points | unic::views::encode_utf8, mixed));
+
+    // and back from UTF-16
+    EXPECT_TRUE(::std::ranges::equal(units | unic::views::decode_utf16 | unic::views::encode_utf8, mixed));
+}
+
+TEST(u16_literal, transcodes_at_compile_time)
+{
+    static_assert(unic::u16_literal<u8"ascii"> == u"ascii");
+    static_assert(unic::u16_literal<u8"ж中\U0001F600"> == u"ж中\U0001F600");
+    static_assert(unic::u16_literal<u8"">.empty());
+
+    constexpr auto literal = unic::u16_literal<u8"null terminated">;
+    EXPECT_EQ(literal.data()[literal.size()], u'\0');
+    EXPECT_EQ(literal, unic::to_u16string(u8"null terminated"sv));
+}
+} // namespace
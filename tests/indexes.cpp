@@ -0,0 +1,258 @@
+// Offset indexes over UTF-8 buffers and cutting them on code point boundaries
+
+#include "../unic.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+using namespace ::std::string_view_literals;
+using unic::text_unit;
+
+// Sequences of 1 to 4 bytes over several lines, repeated so the indexes need more than one mark
+auto sample(int const repeats) -> ::std::u8string
+{
+    ::std::u8string text;
+    for (int i = 0; i < repeats; ++i)
+        text += u8"line ж\r\n中\U0001F600 ok\nlast\r";
+    return text;
+}
+
+// Byte offsets of the code points of valid text, plus the end
+auto boundaries(::std::u8string_view const text) -> ::std::vector<::std::ptrdiff_t>
+{
+    ::std::vector<::std::ptrdiff_t> result;
+    for (::std::ptrdiff_t i = 0; i < static_cast<::std::ptrdiff_t>(text.size()); ++i)
+    {
+        if ((text[static_cast<::std::size_t>(i)] & 0xC0) != 0x80)
+            result.push_back(i);
+    }
+    result.push_back(static_cast<::std::ptrdiff_t>(text.size()));
+    return result;
+}
+
+TEST(utf8_indexed_view, maps_indexes_and_offsets)
+{
+    auto const text = sample(20);
+    auto const offsets = boundaries(text);
+    auto const decoded = unic::to_u32string(text);
+    ::std::u32string_view const code_points = decoded;
+
+    for (auto const stride : {1, 3, 64})
+    {
+        unic::utf8_indexed_view const view{text, stride};
+        ASSERT_EQ(view.size(), static_cast<::std::ptrdiff_t>(code_points.size()));
+        EXPECT_EQ(view.stride(), stride);
+
+        for (::std::ptrdiff_t n = 0; n <= view.size(); ++n)
+        {
+            auto const offset = offsets[static_cast<::std::size_t>(n)];
+            EXPECT_EQ(view.offset_of(n), offset);
+            EXPECT_EQ(view.index_of(offset), n);
+            if (n < view.size())
+            {
+                EXPECT_EQ(view[n], code_points[static_cast<::std::size_t>(n)]);
+            }
+        }
+
+        EXPECT_EQ(view.advance(offsets[5], 7), offsets[12]);
+        EXPECT_EQ(view.distance(offsets[5], offsets[40]), 35);
+    }
+
+    ::std::u32string iterated;
+    for (char32_t const code_point : unic::utf8_indexed_view{text})
+        iterated.push_back(code_point);
+    EXPECT_EQ(iterated, code_points);
+}
+
+TEST(utf8_indexed_view, empty_text)
+{
+    unic::utf8_indexed_view const view{u8""sv};
+    EXPECT_EQ(view.size(), 0);
+    EXPECT_EQ(view.offset_of(0), 0);
+    EXPECT_EQ(view.index_of(0), 0);
+}
+
+TEST(utf8_indexed_view, rejects_a_stride_below_one)
+{
+#if UNIC_EXCEPTIONS
+    for (::std::ptrdiff_t const stride : {0, -1, -64})
+        EXPECT_THROW((unic::utf8_indexed_view{u8"abc"sv, stride}), ::std::invalid_argument);
+    EXPECT_NO_THROW((unic::utf8_indexed_view{u8"abc"sv, 1}));
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(utf8_indexed_view, begin_throws_on_an_invalid_first_sequence)
+{
+#if UNIC_EXCEPTIONS
+    unic::utf8_indexed_view const view{u8"\xE2\x82"sv};
+    EXPECT_THROW((void)view.begin(), unic::utf_error);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(line_index, ascii_and_unicode_breaks)
+{
+    auto const text = u8"one\ntwo\r\nthree\rfour\u2028five\u0085six\n"sv;
+
+    unic::line_index const ascii{text};
+    ASSERT_EQ(ascii.size(), 4);
+    EXPECT_EQ(ascii.line_start(1), 4);
+    EXPECT_EQ(ascii.line_start(2), 9);
+    EXPECT_EQ(ascii.line_start(3), static_cast<::std::ptrdiff_t>(text.size()));
+    EXPECT_EQ(ascii.line_of(0), 0);
+    EXPECT_EQ(ascii.line_of(8), 1);
+    EXPECT_EQ(ascii.line_of(9), 2);
+
+    unic::line_index const unicode{text, unic::line_breaks::unicode};
+    ASSERT_EQ(unicode.size(), 7);
+    EXPECT_EQ(unicode.line_start(3), 15); // after the lone \r
+    EXPECT_EQ(unicode.line_start(4), 22); // after LS, 3 bytes
+    EXPECT_EQ(unicode.line_start(5), 28); // after NEL, 2 bytes
+    EXPECT_EQ(unicode.line_of(16), 3);
+}
+
+TEST(line_index, many_lines)
+{
+    // more lines than a block holds, of varying length
+    ::std::u8string text;
+    ::std::vector<::std::ptrdiff_t> starts{0};
+    for (int line = 0; line < 1000; ++line)
+    {
+        text.append(static_cast<::std::size_t>(line % 300), u8'x');
+        text += u8'\n';
+        starts.push_back(static_cast<::std::ptrdiff_t>(text.size()));
+    }
+
+    unic::line_index const index{text};
+    ASSERT_EQ(index.size(), static_cast<::std::ptrdiff_t>(starts.size()));
+    for (::std::size_t line = 0; line < starts.size(); ++line)
+    {
+        EXPECT_EQ(index.line_start(static_cast<::std::ptrdiff_t>(line)), starts[line]);
+        EXPECT_EQ(index.line_of(starts[line]), static_cast<::std::ptrdiff_t>(line));
+        if (line != 0)
+        {
+            EXPECT_EQ(index.line_of(starts[line] - 1), static_cast<::std::ptrdiff_t>(line) - 1);
+        }
+    }
+}
+
+TEST(utf8_position_index, converts_between_units)
+{
+    auto const text = u8"aж\n中\U0001F600b\r\nc"sv;
+    unic::utf8_position_index const index{text, 4};
+    EXPECT_EQ(index.line_count(), 3);
+
+    // 'b' sits at byte 11, UTF-16 unit 6, code point 5
+    EXPECT_EQ(index.convert(11, text_unit::byte, text_unit::utf16), 6);
+    EXPECT_EQ(index.convert(6, text_unit::utf16, text_unit::code_point), 5);
+    EXPECT_EQ(index.convert(5, text_unit::code_point, text_unit::byte), 11);
+
+    auto const position = index.position_of(6, text_unit::utf16);
+    EXPECT_EQ(position.line, 1);
+    EXPECT_EQ(position.column, 3);
+    EXPECT_EQ(index.offset_of({1, 3}, text_unit::utf16), 6);
+    EXPECT_EQ(index.offset_of({2, 0}, text_unit::byte), 14);
+}
+
+// An index updated in place has to match one built from scratch over the edited text
+void expect_same(unic::utf8_position_index<> const &index, ::std::u8string const &text)
+{
+    unic::utf8_position_index const fresh{text, 8};
+    ASSERT_EQ(index.line_count(), fresh.line_count());
+    for (auto const offset : boundaries(text))
+    {
+        auto const expected = fresh.position_of(offset, text_unit::byte);
+        auto const actual = index.position_of(offset, text_unit::byte);
+        EXPECT_EQ(actual.line, expected.line);
+        EXPECT_EQ(actual.column, expected.column);
+        EXPECT_EQ(index.convert(offset, text_unit::byte, text_unit::utf16),
+                  fresh.convert(offset, text_unit::byte, text_unit::utf16));
+    }
+}
+
+TEST(utf8_position_index, apply_edit_matches_a_rebuild)
+{
+    auto text = sample(10);
+    unic::utf8_position_index index{text, 8};
+    auto const edit = [&](::std::ptrdiff_t const first, ::std::ptrdiff_t const removed,
+                          ::std::u8string_view const inserted) {
+        text.replace(static_cast<::std::size_t>(first), static_cast<::std::size_t>(removed), inserted);
+        index.apply_edit(text, first, removed, static_cast<::std::ptrdiff_t>(inserted.size()));
+        expect_same(index, text);
+    };
+
+    edit(0, 0, u8"new first line\n");
+    edit(20, 3, u8"");  // a line break half removed
+    edit(15, 0, u8"\r"); // a lone \r, then joined into \r\n
+    edit(16, 0, u8"\n");
+    edit(40, 31, u8"жж\n\n中");
+    edit(static_cast<::std::ptrdiff_t>(text.size()) - 4, 4, u8"\U0001F600\r\n");
+}
+
+TEST(utf8_position_index, apply_edit_keeps_the_index_on_error)
+{
+#if UNIC_EXCEPTIONS
+    auto text = sample(10);
+    unic::utf8_position_index index{text, 8};
+
+    auto edited = text;
+    edited.insert(30, u8"\xE2\x82");
+    EXPECT_THROW(index.apply_edit(edited, 30, 0, 2), unic::utf_error);
+
+    // still describes the text before the edit
+    expect_same(index, text);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(truncation, cuts_on_code_point_boundaries)
+{
+    auto const text = u8"aж中\U0001F600"sv; // bytes 0, 1, 3, 6, end at 10
+    auto const cut = [&](::std::ptrdiff_t const max) { return unic::truncate_utf8(text, max).size(); };
+    EXPECT_EQ(cut(0), 0u);
+    EXPECT_EQ(cut(2), 1u);
+    EXPECT_EQ(cut(3), 3u);
+    EXPECT_EQ(cut(5), 3u);
+    EXPECT_EQ(cut(9), 6u);
+    EXPECT_EQ(cut(10), 10u);
+    EXPECT_EQ(cut(100), 10u);
+
+    // 1, 1, 1 then 2 UTF-16 units
+    auto const fit = [&](::std::ptrdiff_t const max) { return unic::utf16_prefix_fitting(text, max).size(); };
+    EXPECT_EQ(fit(0), 0u);
+    EXPECT_EQ(fit(1), 1u);
+    EXPECT_EQ(fit(3), 6u);
+    EXPECT_EQ(fit(4), 6u);
+    EXPECT_EQ(fit(5), 10u);
+}
+
+TEST(truncation, budgets_below_one_give_an_empty_prefix)
+{
+    for (auto const text : {u8"aж中\U0001F600"sv, u8"\U0001F600"sv, u8""sv})
+    {
+        for (::std::ptrdiff_t const max : {0, -1, -100})
+        {
+            EXPECT_TRUE(unic::truncate_utf8(text, max).empty());
+            EXPECT_TRUE(unic::utf16_prefix_fitting(text, max).empty());
+        }
+    }
+}
+
+TEST(truncation, skips_ascii_words)
+{
+    auto const text = ::std::u8string(40, u8'a') + u8"\U0001F600";
+    EXPECT_EQ(unic::utf16_prefix_fitting(text, 41).size(), 40u);
+    EXPECT_EQ(unic::utf16_prefix_fitting(text, 42).size(), 44u);
+    EXPECT_EQ(unic::truncate_utf8(text, 43).size(), 40u);
+}
+} // namespace
@@ -0,0 +1,177 @@
+// The instrumentation counters, in a binary of its own since UNIC_INSTRUMENT changes the header
+
+#define UNIC_INSTRUMENT 1
+#include "../unic.h"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <list>
+#include <string>
+#include <string_view>
+
+namespace
+{
+using namespace ::std::string_view_literals;
+
+// 32 bytes of ASCII, then 1 to 4 byte sequences: 44 code points, 45 UTF-16 units
+auto const text = u8"plain ASCII for the block paths ж中\U0001F600 and more"sv;
+
+auto taken() -> unic::instrumentation::counters
+{
+    auto const values = unic::instrumentation::local();
+    unic::instrumentation::reset();
+    return values;
+}
+
+class instrumentation : public ::testing::Test
+{
+  protected:
+    void SetUp() override { unic::instrumentation::reset(); }
+};
+
+TEST_F(instrumentation, units_out_is_in_the_unit_of_the_output)
+{
+    ::std::u32string code_points(text.size(), U'\0');
+    unic::to_utf32(text, code_points.data());
+    auto counts = taken();
+    EXPECT_EQ(counts.bytes_in, text.size());
+    EXPECT_EQ(counts.units_out, 44u);
+    EXPECT_EQ(counts.fast_path_bytes + counts.slow_path_bytes, text.size());
+    EXPECT_EQ(counts.non_ascii_runs, 1u);
+
+    ::std::u16string units(text.size(), u'\0');
+    unic::to_utf16(text, units.data());
+    EXPECT_EQ(taken().units_out, 45u);
+
+    unic::to_utf16(text, units.data(), unic::engines::dfa{});
+    counts = taken();
+    EXPECT_EQ(counts.bytes_in, text.size());
+    EXPECT_EQ(counts.units_out, 45u);
+
+    // non-contiguous sources go through from_utf8_range
+    ::std::list<char8_t> const list(text.begin(), text.end());
+    unic::to_utf16(list, units.data());
+    counts = taken();
+    EXPECT_EQ(counts.bytes_in, text.size());
+    EXPECT_EQ(counts.slow_path_bytes, text.size());
+    EXPECT_EQ(counts.units_out, 45u);
+}
+
+TEST_F(instrumentation, utf16_and_utf32_kernels)
+{
+    auto const code_points = unic::to_u32string(text);
+    auto const units = unic::to_u16string(text);
+    (void)taken();
+
+    ::std::u16string encoded;
+    unic::to_utf16(code_points, ::std::back_inserter(encoded));
+    auto counts = taken();
+    EXPECT_EQ(counts.bytes_in, code_points.size() * 4);
+    EXPECT_EQ(counts.units_out, units.size());
+
+    ::std::u32string decoded(units.size(), U'\0');
+    unic::to_utf32(units, decoded.data());
+    counts = taken();
+    EXPECT_EQ(counts.bytes_in, units.size() * 2);
+    EXPECT_EQ(counts.fast_path_bytes + counts.slow_path_bytes, units.size() * 2);
+    EXPECT_EQ(counts.units_out, code_points.size());
+}
+
+TEST_F(instrumentation, non_contiguous_utf16_and_utf32_sources)
+{
+    auto const code_points = unic::to_u32string(text);
+    auto const units = unic::to_u16string(text);
+    (void)taken();
+
+    ::std::list<char32_t> const code_point_list(code_points.begin(), code_points.end());
+    ::std::u16string encoded;
+    unic::to_utf16(code_point_list, ::std::back_inserter(encoded));
+    auto counts = taken();
+    EXPECT_EQ(counts.bytes_in, code_points.size() * 4);
+    EXPECT_EQ(counts.slow_path_bytes, code_points.size() * 4);
+    EXPECT_EQ(counts.units_out, units.size());
+
+    ::std::list<char16_t> const unit_list(units.begin(), units.end());
+    ::std::u32string decoded;
+    unic::to_utf32(unit_list, ::std::back_inserter(decoded));
+    counts = taken();
+    EXPECT_EQ(counts.bytes_in, units.size() * 2);
+    EXPECT_EQ(counts.slow_path_bytes, units.size() * 2);
+    EXPECT_EQ(counts.units_out, code_points.size());
+}
+
+TEST_F(instrumentation, null_terminated_mutable_pointers_take_the_word_path)
+{
+    ::std::u8string buffer(text);
+    char8_t *const str = buffer.data();
+
+    ::std::u32string code_points;
+    unic::to_utf32(str, unic::null_terminator{}, ::std::back_inserter(code_points));
+    auto const counts = taken();
+    EXPECT_EQ(code_points, ::std::u32string_view{unic::to_u32string(text)});
+    EXPECT_EQ(counts.bytes_in, text.size());
+#if UNIC_ALIGNED_OVERREAD
+    EXPECT_GT(counts.fast_path_bytes, 0u);
+#else
+    EXPECT_EQ(counts.fast_path_bytes, 0u);
+#endif
+}
+
+TEST_F(instrumentation, single_byte_kernels)
+{
+    auto const bytes = "caf\xE9 and 30 more bytes of plain text"sv;
+
+    ::std::u8string utf8(bytes.size() * 2, u8'\0');
+    unic::latin1::to_utf8(bytes, utf8.data());
+    auto counts = taken();
+    EXPECT_EQ(counts.bytes_in, bytes.size());
+    EXPECT_EQ(counts.units_out, bytes.size() + 1);
+    EXPECT_EQ(counts.fast_path_bytes + counts.slow_path_bytes, bytes.size());
+
+    ::std::string back;
+    unic::code_pages::from_utf8(unic::code_pages::windows_1252, u8"café €"sv, ::std::back_inserter(back));
+    counts = taken();
+    EXPECT_EQ(counts.bytes_in, 9u);
+    EXPECT_EQ(counts.slow_path_bytes, 9u);
+    EXPECT_EQ(counts.units_out, 6u);
+}
+
+TEST(conversion_profile, counts_the_paths_taken)
+{
+    // an ASCII word, 4 two byte sequences, 2 three byte ones, then a tail too short for a block
+    auto const blocks = u8"abcdefghжжжж中中xy"sv;
+    ::std::u32string code_points(blocks.size(), U'\0');
+    unic::conversion_profile profile;
+    unic::to_utf32(blocks, code_points.data(), profile);
+    EXPECT_EQ(profile.ascii_blocks, 1u);
+    EXPECT_EQ(profile.two_byte_blocks, 1u);
+    EXPECT_EQ(profile.three_byte_blocks, 1u);
+    EXPECT_EQ(profile.generic_sequences, 2u);
+    EXPECT_EQ(profile.errors, 0u);
+
+    // the profile starts over on every call
+    unic::to_utf32(u8"\U0001F600"sv, code_points.data(), profile);
+    EXPECT_EQ(profile.ascii_blocks, 0u);
+    EXPECT_EQ(profile.generic_sequences, 1u);
+
+#if UNIC_EXCEPTIONS
+    EXPECT_THROW(unic::to_utf32(u8"abc\xFF"sv, code_points.data(), profile), unic::utf_error);
+    EXPECT_EQ(profile.generic_sequences, 4u);
+    EXPECT_EQ(profile.errors, 1u);
+#endif
+}
+
+TEST_F(instrumentation, errors_keep_what_went_through)
+{
+#if UNIC_EXCEPTIONS
+    ::std::u32string code_points(16, U'\0');
+    EXPECT_THROW(unic::to_utf32(u8"ab\xFF"sv, code_points.data()), unic::utf_error);
+    auto const counts = taken();
+    EXPECT_EQ(counts.units_out, 2u);
+    EXPECT_EQ(counts.errors[static_cast<::std::size_t>(unic::error_kind::header_length)], 1u);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+} // namespace
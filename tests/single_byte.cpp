@@ -0,0 +1,134 @@
+// Latin-1 and the single-byte code pages, to and from UTF-8 and UTF-16
+
+#include "../unic.h"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <string_view>
+
+namespace
+{
+using namespace ::std::string_view_literals;
+
+// Every byte value, long enough to go through the SSE2 blocks and the scalar tails
+auto all_bytes() -> ::std::string
+{
+    ::std::string bytes;
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int byte = 0; byte < 256; ++byte)
+            bytes += static_cast<char>(byte);
+    }
+    return bytes;
+}
+
+TEST(latin1, round_trips_every_byte)
+{
+    auto const bytes = all_bytes();
+
+    ::std::u8string utf8;
+    unic::latin1::to_utf8(bytes, ::std::back_inserter(utf8));
+    EXPECT_EQ(static_cast<::std::ptrdiff_t>(utf8.size()), unic::latin1::to_utf8_size(bytes));
+    ::std::u32string code_points;
+    for (char const byte : bytes)
+        code_points.push_back(static_cast<unsigned char>(byte));
+    EXPECT_EQ(::std::u32string_view{unic::to_u32string(utf8)}, code_points);
+
+    ::std::string back;
+    unic::latin1::from_utf8(utf8, ::std::back_inserter(back));
+    EXPECT_EQ(static_cast<::std::ptrdiff_t>(back.size()), unic::latin1::from_utf8_size(utf8));
+    EXPECT_EQ(back, bytes);
+
+    ::std::u16string utf16;
+    unic::latin1::to_utf16(bytes, ::std::back_inserter(utf16));
+    EXPECT_EQ(utf16, ::std::u16string_view{unic::to_u16string(utf8)});
+
+    back.clear();
+    unic::latin1::from_utf16(utf16, ::std::back_inserter(back));
+    EXPECT_EQ(back, bytes);
+}
+
+TEST(latin1, rejects_what_it_cannot_hold)
+{
+#if UNIC_EXCEPTIONS
+    ::std::string out;
+    EXPECT_THROW(unic::latin1::from_utf8(u8"café Ā"sv, ::std::back_inserter(out)), unic::utf_error);
+    EXPECT_THROW(unic::latin1::from_utf16(u"€"sv, ::std::back_inserter(out)), unic::utf_error);
+    EXPECT_THROW(unic::latin1::from_utf8(u8"\xC3"sv, ::std::back_inserter(out)), unic::utf_error);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+
+TEST(code_pages, decode_and_encode)
+{
+    EXPECT_EQ(unic::code_pages::windows_1251.decode('\xC6'), U'Ж');
+    EXPECT_EQ(unic::code_pages::koi8_r.decode('\xF6'), U'Ж');
+    EXPECT_EQ(unic::code_pages::windows_1252.decode('\x80'), U'€');
+    EXPECT_EQ(unic::code_pages::iso_8859_15.decode('\xA4'), U'€');
+    EXPECT_EQ(unic::code_pages::windows_1250.decode('\x81'), U'\u0081'); // undefined, kept as C1
+
+    EXPECT_EQ(unic::code_pages::koi8_r.encode(U'Ж'), 0xF6);
+    EXPECT_EQ(unic::code_pages::koi8_r.encode(U'A'), 'A');
+    EXPECT_EQ(unic::code_pages::koi8_r.encode(U'€'), -1);
+    EXPECT_EQ(unic::code_pages::iso_8859_5.encode(U'\U0001F600'), -1);
+}
+
+TEST(code_pages, round_trip_every_byte)
+{
+    auto const bytes = all_bytes();
+    for (auto const *const page :
+         {&unic::code_pages::windows_1250, &unic::code_pages::windows_1251, &unic::code_pages::windows_1252,
+          &unic::code_pages::koi8_r, &unic::code_pages::koi8_u, &unic::code_pages::iso_8859_2,
+          &unic::code_pages::iso_8859_5, &unic::code_pages::iso_8859_15})
+    {
+        ::std::u32string code_points;
+        unic::code_pages::to_utf32(*page, bytes, ::std::back_inserter(code_points));
+        ASSERT_EQ(code_points.size(), bytes.size());
+        for (::std::size_t i = 0; i < bytes.size(); ++i)
+            EXPECT_EQ(code_points[i], page->decode(bytes[i]));
+
+        ::std::u8string utf8;
+        unic::code_pages::to_utf8(*page, bytes, ::std::back_inserter(utf8));
+        EXPECT_EQ(static_cast<::std::ptrdiff_t>(utf8.size()), unic::code_pages::to_utf8_size(*page, bytes));
+        EXPECT_EQ(::std::u32string_view{unic::to_u32string(utf8)}, code_points);
+
+        ::std::u16string utf16;
+        unic::code_pages::to_utf16(*page, bytes, ::std::back_inserter(utf16));
+        EXPECT_EQ(utf16, ::std::u16string_view{unic::to_u16string(utf8)});
+
+        ::std::string back;
+        unic::code_pages::from_utf8(*page, utf8, ::std::back_inserter(back));
+        EXPECT_EQ(static_cast<::std::ptrdiff_t>(back.size()), unic::code_pages::from_utf8_size(utf8));
+        EXPECT_EQ(back, bytes);
+
+        back.clear();
+        unic::code_pages::from_utf16(*page, utf16, ::std::back_inserter(back));
+        EXPECT_EQ(back, bytes);
+
+        // raw pointer outputs take the block kernels
+        ::std::u16string blocks(bytes.size(), u'\0');
+        unic::code_pages::to_utf16(*page, bytes, blocks.data());
+        EXPECT_EQ(blocks, utf16);
+
+        EXPECT_TRUE(::std::ranges::equal(bytes | unic::views::decode_code_page(*page), code_points));
+    }
+}
+
+TEST(code_pages, reject_what_the_page_lacks)
+{
+#if UNIC_EXCEPTIONS
+    ::std::string out;
+    EXPECT_THROW(unic::code_pages::from_utf8(unic::code_pages::koi8_r, u8"жук €"sv, ::std::back_inserter(out)),
+                 unic::utf_error);
+    EXPECT_EQ(out, "\xD6\xD5\xCB ");
+    EXPECT_THROW(unic::code_pages::from_utf16(unic::code_pages::windows_1251, u"é"sv, ::std::back_inserter(out)),
+                 unic::utf_error);
+#else
+    GTEST_SKIP() << "errors abort without exceptions";
+#endif
+}
+} // namespace
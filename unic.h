@@ -3,13 +3,57 @@
 // Written by Ayxan Haqverdili
 // 2021 June 04
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
 #include <iterator>
 #include <ranges>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
+#include <vector>
 #include <bit>
 
+// SIMD kernels are used where the target has them; define UNIC_NO_SIMD to keep the portable ones
+#if !defined(UNIC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define UNIC_SSE2 1
+#include <emmintrin.h>
+#else
+#define UNIC_SSE2 0
+#endif
+
+// Kernels over null-terminated strings read whole aligned words, possibly past the terminator
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define UNIC_ASAN 1
+#endif
+#endif
+#if defined(UNIC_NO_SIMD) || defined(__SANITIZE_ADDRESS__) || defined(UNIC_ASAN)
+#define UNIC_ALIGNED_OVERREAD 0
+#else
+#define UNIC_ALIGNED_OVERREAD 1
+#endif
+
+// Without exceptions (UNIC_NO_EXCEPTIONS, or compiled with them off) conversion errors end in std::abort
+#if defined(UNIC_NO_EXCEPTIONS) || !(defined(__cpp_exceptions) || defined(_CPPUNWIND))
+#define UNIC_EXCEPTIONS 0
+#else
+#define UNIC_EXCEPTIONS 1
+#endif
+
+// Define UNIC_INSTRUMENT to 1 to have the bulk converters keep per thread counters, see unic::instrumentation.
+// Has to be the same in every translation unit of a program.
+#ifndef UNIC_INSTRUMENT
+#define UNIC_INSTRUMENT 0
+#endif
+
 namespace unic
 {
 
@@ -42,6 +86,15 @@ concept sized_forward_range_for =
 
 template <class InputRange, class Type>
 concept input_range_for = ::std::ranges::input_range<InputRange> &&range_for<InputRange, Type>;
+
+// Single-pass byte sources; char and unsigned char count as UTF-8 too (std::istreambuf_iterator<char>)
+template <class Iter>
+concept byte_input_iterator = ::std::input_iterator<Iter> &&
+                              (iterator_for<Iter, char8_t> || iterator_for<Iter, char> || iterator_for<Iter, unsigned char>);
+
+template <class ContiguousRange, class Type>
+concept contiguous_range_for =
+    ::std::ranges::contiguous_range<ContiguousRange> && sized_range_for<ContiguousRange, Type>;
 } // namespace concepts
 
 // Exception classes
@@ -60,263 +113,3605 @@ struct utf_positioned_error : utf_error
     [[no_unique_address]] src_iter error_position{};
 
     utf_positioned_error(src_iter err_pos, ::std::string const &msg)
-        : error_position(::std::move(err_pos))
-        , utf_error(::std::move(msg))
+        : utf_error(msg)
+        , error_position(::std::move(err_pos))
     {
     }
 };
 
-// utf8 to code points
-template <concepts::forward_iterator_for<char8_t> src_iter, ::std::sized_sentinel_for<src_iter> src_end_iter>
-class from_utf8_range final
+enum class error_kind : unsigned char
 {
-  private:
-    [[no_unique_address]] src_iter m_begin{};
-    [[no_unique_address]] src_end_iter m_end{};
-
-  public:
-    struct iterator final // forward_iterator
-    {
-      private:
-        friend class from_utf8_range;
+    header_length,
+    trail_byte,
+    out_of_utf16_range,
+    out_of_unicode_range,
+    unpaired_low_surrogate,
+    unpaired_high_surrogate,
+    out_of_latin1_range,
+    not_in_code_page,
+};
 
-        [[no_unique_address]] src_iter m_begin{};
-        [[no_unique_address]] src_end_iter m_end{};
+inline constexpr ::std::size_t error_kind_count = 8;
 
-        constexpr iterator(src_iter begin, src_end_iter end) noexcept
-            : m_begin(::std::move(begin))
-            , m_end(::std::move(end))
-        {
-        }
+// What went through the converters of the calling thread: the bulk conversions, the latin1 and
+// code_pages kernels, to_utf16_iter and the decoding of from_utf8_range and from_utf8_input_range.
+// The counters only move with UNIC_INSTRUMENT on; otherwise every hook compiles to nothing.
+namespace instrumentation
+{
+inline constexpr bool enabled = UNIC_INSTRUMENT != 0;
 
-        // returns -1 on fail
-        [[nodiscard]] static constexpr int compute_byte_count(char8_t const header) noexcept
-        {
-            auto const cnt = ::std::countl_one(static_cast<unsigned char>(header));
-            if (cnt == 0)
-                return 1;
+struct counters
+{
+    ::std::uint64_t bytes_in = 0;        // of the source, 2 per UTF-16 unit and 4 per code point
+    ::std::uint64_t units_out = 0;       // written, in the unit of the output
+    ::std::uint64_t fast_path_bytes = 0; // taken a block at a time
+    ::std::uint64_t slow_path_bytes = 0; // taken a sequence at a time
+    ::std::uint64_t non_ascii_runs = 0;  // in UTF-8 sources
+    ::std::array<::std::uint64_t, error_kind_count> errors{}; // indexed by error_kind
+};
 
-            if (cnt < 2 || cnt > 6)
-                return -1;
+[[nodiscard]] inline auto local() noexcept -> counters &
+{
+    thread_local counters values;
+    return values;
+}
 
-            return cnt;
-        }
+inline void reset() noexcept { local() = counters{}; }
+} // namespace instrumentation
 
-      public:
-        constexpr iterator() = default; // required for the iterator concept apparently
+namespace detail
+{
+[[nodiscard]] constexpr auto message_of(error_kind const kind) noexcept -> char const *
+{
+    switch (kind)
+    {
+    case error_kind::header_length:
+        return "Length in header byte is wrong";
+    case error_kind::trail_byte:
+        return "Illegal trail byte";
+    case error_kind::out_of_utf16_range:
+        return "Out of UTF-16 range";
+    case error_kind::out_of_unicode_range:
+        return "Out of Unicode range";
+    case error_kind::unpaired_low_surrogate:
+        return "Unpaired low surrogate";
+    case error_kind::unpaired_high_surrogate:
+        return "Unpaired high surrogate";
+    case error_kind::out_of_latin1_range:
+        return "Out of Latin-1 range";
+    case error_kind::not_in_code_page:
+        return "Not in the code page";
+    }
+    return "Invalid encoding";
+}
 
-        using iterator_category = ::std::forward_iterator_tag;
-        using difference_type = ::std::ptrdiff_t;
-        using value_type = char32_t;
+// Every conversion error goes through here
+template <class src_iter>
+[[noreturn]] constexpr void fail([[maybe_unused]] src_iter pos, error_kind const kind)
+{
+    if constexpr (instrumentation::enabled)
+    {
+        if (!::std::is_constant_evaluated())
+            ++instrumentation::local().errors[static_cast<::std::size_t>(kind)];
+    }
+#if UNIC_EXCEPTIONS
+    throw utf_positioned_error(::std::move(pos), message_of(kind));
+#else
+    ::std::abort();
+#endif
+}
 
-        [[maybe_unused]] constexpr auto operator++() -> iterator &
+// Runs a kernel over data, the raw pointer behind the caller's contiguous first. The kernel's
+// errors are rethrown positioned at the caller's iterator, so a caller catches
+// utf_positioned_error<src_iter> whichever path the conversion took.
+template <class src_iter, class unit, class kernel>
+constexpr auto caller_positioned([[maybe_unused]] src_iter const &first, [[maybe_unused]] unit const *const data,
+                                 kernel const &run) -> decltype(run())
+{
+#if UNIC_EXCEPTIONS
+    if constexpr (!::std::is_same_v<src_iter, unit const *>)
+    {
+        try
         {
-            auto const cnt = compute_byte_count(*m_begin);
-            if (cnt == -1 || cnt > m_end - m_begin)
-                throw utf_positioned_error(m_begin, "Length in header byte is wrong");
-
-            ::std::advance(m_begin, cnt);
-
-            return *this;
+            return run();
         }
-
-        [[nodiscard]] constexpr auto operator++(int) -> iterator
+        catch (utf_positioned_error<unit const *> const &error)
         {
-            auto copy = *this;
-            ++*this;
-            return copy;
+            throw utf_positioned_error<src_iter>(first + (error.error_position - data), error.what());
         }
+    }
+#endif
+    return run();
+}
 
-        [[nodiscard]] constexpr auto operator*() const -> char32_t
-        {
-            auto const cnt = compute_byte_count(*m_begin);
-            if (cnt == -1 || cnt > m_end - m_begin)
-                throw utf_positioned_error(m_begin, "Length in header byte is wrong");
-
-            char32_t code_point = 0;
+// Tallies one bulk conversion and adds it to the thread's counters when done, even when it throws
+struct tally
+{
+    ::std::uint64_t bytes_in = 0;
+    ::std::uint64_t units_out = 0;
+    ::std::uint64_t fast_path_bytes = 0;
+    ::std::uint64_t slow_path_bytes = 0;
+    ::std::uint64_t non_ascii_runs = 0;
 
-            if (cnt == 1) // ascii
-                code_point = *m_begin;
-            else
+    constexpr ~tally()
+    {
+        if constexpr (instrumentation::enabled)
+        {
+            if (!::std::is_constant_evaluated())
             {
-                // extract trailing bits
-                auto begin = m_begin;
-                code_point = static_cast<char32_t>(*begin++ & (static_cast<char8_t>(~0u) >> (cnt + 1)));
-
-                // extract rest of the bytes
-                for (int i = 1; i < cnt; ++i)
-                {
-                    if (*begin < 0x80 || 0xBF < *begin)
-                        throw utf_positioned_error(begin, "Illegal trail byte");
-
-                    code_point = (code_point << 6) | (*begin & 0x3F);
-                    ++begin;
-                }
+                auto &totals = instrumentation::local();
+                totals.bytes_in += bytes_in;
+                totals.units_out += units_out;
+                totals.fast_path_bytes += fast_path_bytes;
+                totals.slow_path_bytes += slow_path_bytes;
+                totals.non_ascii_runs += non_ascii_runs;
             }
-            return code_point;
         }
+    }
 
-        [[nodiscard]] constexpr auto operator==(iterator const &other) const noexcept -> bool
+    // bytes went through a block path, writing units
+    constexpr void block(::std::uint64_t const bytes, ::std::uint64_t const units) noexcept
+    {
+        if constexpr (instrumentation::enabled)
         {
-            return m_begin == other.m_begin;
+            fast_path_bytes += bytes;
+            units_out += units;
         }
-    };
+    }
 
-  public:
-    constexpr from_utf8_range(src_iter begin, src_end_iter end) noexcept
-        : m_begin(::std::move(begin))
-        , m_end(::std::move(end))
+    // bytes went through a sequence at a time path, writing units
+    constexpr void sequence(::std::uint64_t const bytes, ::std::uint64_t const units) noexcept
     {
+        if constexpr (instrumentation::enabled)
+        {
+            slow_path_bytes += bytes;
+            units_out += units;
+        }
     }
+};
 
-    template <concepts::sized_range_for<char8_t> u8range>
-    constexpr from_utf8_range(u8range const &range) noexcept
-        : from_utf8_range(::std::ranges::begin(range), ::std::ranges::end(range))
+// What a decoder adds to units_out per code point it writes to out. A to_utf16_iter counts the units it
+// writes itself, so the decoders feeding it count none (specialized next to it).
+template <class code_point_out>
+inline constexpr ::std::uint64_t code_point_units = 1;
+} // namespace detail
+
+// Decoder lookup tables, generated at compile time
+namespace tables
+{
+// Sequence length announced by a header byte, -1 if the byte can't start a sequence.
+// Lenient - counts the obsolete 5/6 byte forms.
+inline constexpr auto header_length = [] {
+    ::std::array<::std::int8_t, 256> table{};
+    for (int byte = 0; byte < 256; ++byte)
     {
+        auto const cnt = ::std::countl_one(static_cast<unsigned char>(byte));
+        table[byte] = static_cast<::std::int8_t>(cnt == 0 ? 1 : (cnt < 2 || cnt > 6) ? -1 : cnt);
     }
+    return table;
+}();
 
-    // all iterators are const
-    [[nodiscard]] constexpr auto begin() const noexcept { return iterator(m_begin, m_end); }
-    [[nodiscard]] constexpr auto end() const noexcept { return iterator{m_end, m_end}; }
-    [[nodiscard]] constexpr auto cbegin() const noexcept { return begin(); }
-    [[nodiscard]] constexpr auto cend() const noexcept { return end(); }
+// Character classes of the DFA engine
+inline constexpr auto dfa_class = [] {
+    ::std::array<::std::uint8_t, 256> table{};
+    for (int byte = 0; byte < 256; ++byte)
+    {
+        if (byte < 0x80)
+            table[byte] = 0; // ascii
+        else if (byte < 0x90)
+            table[byte] = 1; // trail 80..8F
+        else if (byte < 0xA0)
+            table[byte] = 9; // trail 90..9F
+        else if (byte < 0xC0)
+            table[byte] = 7; // trail A0..BF
+        else if (byte < 0xC2)
+            table[byte] = 8; // overlong 2 byte lead
+        else if (byte < 0xE0)
+            table[byte] = 2;
+        else if (byte == 0xE0)
+            table[byte] = 10; // needs A0..BF next
+        else if (byte == 0xED)
+            table[byte] = 4; // needs 80..9F next, surrogates otherwise
+        else if (byte < 0xF0)
+            table[byte] = 3;
+        else if (byte == 0xF0)
+            table[byte] = 11; // needs 90..BF next
+        else if (byte < 0xF4)
+            table[byte] = 6;
+        else if (byte == 0xF4)
+            table[byte] = 5; // needs 80..8F next, above U+10FFFF otherwise
+        else
+            table[byte] = 8; // F5..FF
+    }
+    return table;
+}();
+
+// Strict (RFC 3629) view of a lead byte: sequence length (0 if invalid as a lead)
+// and the range the second byte must fall in
+struct lead_info
+{
+    ::std::int8_t length;
+    char8_t second_min;
+    char8_t second_max;
 };
 
-template <concepts::sized_range_for<char8_t> u8range>
-from_utf8_range(u8range const &range) noexcept->from_utf8_range<::std::decay_t<decltype(::std::ranges::begin(range))>,
-                                                                ::std::decay_t<decltype(::std::ranges::end(range))>>;
+inline constexpr auto strict_lead = [] {
+    ::std::array<lead_info, 256> table{};
+    for (int byte = 0; byte < 256; ++byte)
+    {
+        lead_info info{0, 0x80, 0xBF};
+        if (byte < 0x80)
+            info.length = 1;
+        else if (0xC2 <= byte && byte < 0xE0)
+            info.length = 2;
+        else if (0xE0 <= byte && byte < 0xF0)
+            info.length = 3;
+        else if (0xF0 <= byte && byte < 0xF5)
+            info.length = 4;
 
-// Code points to utf16
-template <::std::output_iterator<char16_t> out_iter>
-class to_utf16_iter final
+        if (byte == 0xE0)
+            info.second_min = 0xA0;
+        else if (byte == 0xED)
+            info.second_max = 0x9F;
+        else if (byte == 0xF0)
+            info.second_min = 0x90;
+        else if (byte == 0xF4)
+            info.second_max = 0x8F;
+
+        table[byte] = info;
+    }
+    return table;
+}();
+} // namespace tables
+
+namespace detail
 {
-  private:
-    [[no_unique_address]] out_iter m_iter{};
+// End of a buffer that is known to hold a whole sequence past the current position.
+// Handing it to an engine lets the compiler fold the engine's length checks away.
+struct unbounded_end
+{
+    [[nodiscard]] friend constexpr auto operator-(unbounded_end, char8_t const *) noexcept -> ::std::ptrdiff_t
+    {
+        return PTRDIFF_MAX;
+    }
+};
 
-    // Outputs a code-point to a UTF-16 output iterator
-    constexpr void append(char32_t code_point)
+// Whether n more elements are left before end. Walks them if the distance can't be computed,
+// which is the only place unsized sentinels pay for per-byte end checks.
+template <class src_iter, class src_end_iter>
+[[nodiscard]] constexpr auto has_elements(src_iter it, src_end_iter const &end, ::std::ptrdiff_t n) -> bool
+{
+    if constexpr (requires { end - it; })
+        return end - it >= n;
+    else
     {
-        if (code_point <= 0xFFFF)
-        {
-            *m_iter++ = static_cast<char16_t>(code_point);
-        }
-        else if (code_point <= 0x10FFFF)
+        for (; n != 0; --n, ++it)
         {
-            code_point -= 0x10000;
-            *m_iter++ = static_cast<char16_t>((code_point >> 10) + 0xD800);
-            *m_iter++ = static_cast<char16_t>((code_point & 0x3FF) + 0xDC00);
+            if (it == end)
+                return false;
         }
-        else
+        return true;
+    }
+}
+
+// SWAR helpers for contiguous buffers, processing 8 bytes per step
+
+inline constexpr ::std::uint64_t high_bits = 0x8080808080808080u;
+
+[[nodiscard]] constexpr auto is_lead_byte(char8_t const byte) noexcept -> bool { return (byte & 0xC0) != 0x80; }
+
+[[nodiscard]] inline auto load_word(char8_t const *const ptr) noexcept -> ::std::uint64_t
+{
+    ::std::uint64_t word;
+    ::std::memcpy(&word, ptr, sizeof word);
+    return word;
+}
+
+inline constexpr ::std::uint64_t low_bits = 0x0101010101010101u;
+
+// Non-zero if some byte of the word equals byte; may flag extra bytes above a real match
+[[nodiscard]] constexpr auto match_byte(::std::uint64_t const word, char8_t const byte) noexcept -> ::std::uint64_t
+{
+    auto const diff = word ^ (low_bits * byte);
+    return (diff - low_bits) & ~diff & high_bits;
+}
+
+// Bytes of the word that start a sequence: bit 7 clear, or bits 7 and 6 both set
+[[nodiscard]] constexpr auto count_lead_bytes(::std::uint64_t const word) noexcept -> int
+{
+    return ::std::popcount((~word | (word << 1)) & high_bits);
+}
+
+[[nodiscard]] constexpr auto count_lead_bytes(char8_t const *first, char8_t const *const last) noexcept
+    -> ::std::ptrdiff_t
+{
+    ::std::ptrdiff_t count = 0;
+    if (!::std::is_constant_evaluated())
+    {
+#if UNIC_SSE2
+        // lead bytes are those above 0xBF as signed chars; per-byte counters are summed
+        // every 255 blocks before they could wrap
+        auto const trail_max = _mm_set1_epi8(static_cast<char>(0xBF));
+        while (last - first >= 16)
         {
-            throw utf_positioned_error(m_iter, "Out of UTF-16 range");
+            auto counters = _mm_setzero_si128();
+            for (auto blocks = ::std::min<::std::ptrdiff_t>((last - first) / 16, 255); blocks != 0; --blocks)
+            {
+                auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+                counters = _mm_sub_epi8(counters, _mm_cmpgt_epi8(bytes, trail_max));
+                first += 16;
+            }
+            auto const sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+            count += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
         }
+#endif
+        for (; last - first >= 8; first += 8)
+            count += count_lead_bytes(load_word(first));
     }
+    for (; first != last; ++first)
+        count += is_lead_byte(*first);
+    return count;
+}
 
-    struct proxy_assigner
+// Moves past n sequences, counting lead bytes only. Stops at last if the buffer runs out.
+[[nodiscard]] constexpr auto skip_sequences(char8_t const *first, char8_t const *const last,
+                                           ::std::ptrdiff_t n) noexcept -> char8_t const *
+{
+    // whole words that end before the wanted lead byte
+    if (!::std::is_constant_evaluated())
     {
-      private:
-        friend class to_utf16_iter;
-        [[no_unique_address]] to_utf16_iter *m_parent;
-
-        proxy_assigner(to_utf16_iter *parent) noexcept
-            : m_parent{parent}
+        for (; last - first >= 8; first += 8)
         {
+            auto const leads = count_lead_bytes(load_word(first));
+            if (leads > n)
+                break;
+            n -= leads;
         }
+    }
 
-        proxy_assigner(::std::nullptr_t) = delete;
+    // then byte by byte, the lead at first (if any) being number 0
+    for (; first != last; ++first)
+    {
+        if (is_lead_byte(*first) && n-- == 0)
+            break;
+    }
+    return first;
+}
+} // namespace detail
 
-      public:
-        [[maybe_unused]] constexpr auto operator=(char32_t const code_point) const -> proxy_assigner const &
-        {
-            m_parent->append(code_point);
-            return *this;
-        }
+// Decoding engines for from_utf8_range
+// An engine exposes the longest sequence it accepts as max_length
+// and two static functions over a [begin, end) window:
+//   decode(begin, end) -> char32_t  : code point of the sequence starting at begin
+//   next(begin, end)   -> src_iter  : iterator past that sequence
+//   read(begin&, end)  -> char32_t  : both at once, moving begin past the sequence
+namespace engines
+{
+// The original decoder: branches on the header byte length and on every trail byte.
+// Lenient - accepts overlong forms, surrogates and the obsolete 5/6 byte sequences.
+struct branchy final
+{
+    static constexpr int max_length = 6;
 
-        template <class T>
-        proxy_assigner &operator=(T) const = delete;
-    };
+    // returns -1 on fail. ASCII is settled by a compare, which the branch predictor gets right on
+    // runs of it; only lead bytes of longer sequences pay for the table load.
+    [[nodiscard]] static constexpr int compute_byte_count(char8_t const header) noexcept
+    {
+        return header < 0x80 ? 1 : tables::header_length[header];
+    }
 
-  public:
-    to_utf16_iter(out_iter iter) noexcept
-        : m_iter(::std::move(iter))
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto next(src_iter begin, src_end_iter const &end) -> src_iter
     {
+        auto const cnt = compute_byte_count(*begin);
+        if (cnt == -1 || !detail::has_elements(begin, end, cnt))
+            detail::fail(begin, error_kind::header_length);
+
+        ::std::advance(begin, cnt);
+        return begin;
     }
 
-    to_utf16_iter() = default;
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto decode(src_iter begin, src_end_iter const &end) -> char32_t
+    {
+        auto const cnt = compute_byte_count(*begin);
+        if (cnt == -1 || !detail::has_elements(begin, end, cnt))
+            detail::fail(begin, error_kind::header_length);
 
-    using iterator_category = ::std::output_iterator_tag;
-    using difference_type = ::std::ptrdiff_t;
+        if (cnt == 1) // ascii
+            return *begin;
 
-    // Incrementing is no-op for output iterators. Actual incrementing is done on
-    // write
-    [[maybe_unused]] constexpr auto operator++() noexcept -> to_utf16_iter & { return *this; }
-    [[nodiscard]] constexpr auto operator++(int) noexcept -> to_utf16_iter { return *this; }
+        // extract trailing bits
+        auto code_point = static_cast<char32_t>(*begin++ & (static_cast<char8_t>(~0u) >> (cnt + 1)));
 
-    [[nodiscard]] constexpr auto operator*() noexcept -> proxy_assigner { return {this}; }
+        // extract rest of the bytes
+        for (int i = 1; i < cnt; ++i)
+        {
+            if (*begin < 0x80 || 0xBF < *begin)
+                detail::fail(begin, error_kind::trail_byte);
+
+            code_point = (code_point << 6) | (*begin & 0x3F);
+            ++begin;
+        }
+        return code_point;
+    }
+
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto read(src_iter &begin, src_end_iter const &end) -> char32_t
+    {
+        auto const code_point = decode(begin, end); // validates the length as well
+        ::std::advance(begin, compute_byte_count(*begin));
+        return code_point;
+    }
 };
 
-template <concepts::input_iterator_for<char32_t> input_beg, ::std::sentinel_for<input_beg> input_end>
-[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(input_beg beg, input_end const end)
+// Table driven DFA decoder after Bjoern Hoehrmann's "Flexible and Economical UTF-8 Decoder".
+// One class lookup and one transition lookup per byte; the code point update is masked,
+// not a branch. Strict - rejects overlong forms, surrogates and anything above U+10FFFF.
+struct dfa final
 {
-    ::std::ptrdiff_t size = 0;
+    static constexpr int max_length = 4;
 
-    for (; beg != end; ++beg)
+    // States are bit offsets into a row of shift_rows, multiples of 6
+    static constexpr ::std::uint8_t accept = 0;
+    static constexpr ::std::uint8_t reject = 6;
+
+    // Hoehrmann's table: (state * 12 + class) -> state * 12
+    static constexpr ::std::uint8_t transition[108] = {
+        0,  12, 24, 36, 60, 96, 84, 12, 12, 12, 48, 72, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+        12, 0,  12, 12, 12, 12, 12, 0,  12, 0,  12, 12, 12, 24, 12, 12, 12, 12, 12, 24, 12, 24, 12, 12,
+        12, 12, 12, 12, 12, 12, 12, 24, 12, 12, 12, 12, 12, 24, 12, 12, 12, 12, 12, 12, 12, 24, 12, 12,
+        12, 12, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12, 12, 36, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,
+        12, 36, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    };
+
+    // The same automaton in shift form: the row of a byte holds the next state of each of the
+    // 9 states, 6 bits apiece, at the bit offset of that state. Stepping is then a shift of a
+    // row loaded independently of the state, rather than a load that has to wait for it.
+    // The top byte holds the payload bits of the byte: 0x3F for trail bytes, 0xFF >> class for
+    // the rest. A byte that gets the wrong one for the state it comes in rejects anyway.
+    static constexpr auto shift_rows = [] {
+        ::std::array<::std::uint64_t, 256> table{};
+        for (int byte = 0; byte < 256; ++byte)
+        {
+            auto const type = tables::dfa_class[byte];
+            for (int state = 0; state < 9; ++state)
+            {
+                auto const next = transition[state * 12 + type] / 12;
+                table[byte] |= static_cast<::std::uint64_t>(next * 6) << (state * 6);
+            }
+
+            auto const payload = (byte & 0xC0) == 0x80 ? 0x3Fu : 0xFFu >> type;
+            table[byte] |= static_cast<::std::uint64_t>(payload) << 56;
+        }
+        return table;
+    }();
+
+    // Feeds one byte into the automaton. The code point is reset with a mask at a sequence start,
+    // not a select, which compilers turn into a branch that mixed text mispredicts.
+    [[nodiscard]] static constexpr auto step(::std::uint8_t const state, char32_t &code_point,
+                                             char8_t const byte) noexcept -> ::std::uint8_t
     {
-        auto const code_point = *beg;
-        if (code_point <= 0xFFFF)
-            size += 1;
-        else if (code_point <= 0x10FFFF)
-            size += 2;
-        else
-            throw utf_positioned_error(beg, "Out of UTF-16 range");
+        auto const row = shift_rows[byte];
+        auto const inside = char32_t{0} - static_cast<char32_t>(state != accept); // all ones mid-sequence
+        code_point = ((code_point << 6) & inside) | (byte & static_cast<char32_t>(row >> 56));
+        return static_cast<::std::uint8_t>((row >> state) & 63);
     }
 
-    return size;
-}
+    // Runs the automaton over one sequence, returns the iterator past it.
+    // Reject is a sink state, so the loop only has to test for the intermediate states.
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto run(src_iter begin, src_end_iter const &end, char32_t &code_point) -> src_iter
+    {
+        constexpr bool is_sized = requires { end - begin; };
 
-template <concepts::input_range_for<char32_t> u32range>
-[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(u32range const &range)
-{
-    return to_utf16_size(::std::ranges::begin(range), ::std::ranges::end(range));
-}
+        auto const start = begin;
+        ::std::ptrdiff_t available = 0;
+        if constexpr (is_sized)
+            available = end - begin;
 
-template <concepts::forward_iterator_for<char8_t> input_beg, ::std::sized_sentinel_for<input_beg> input_end>
-[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(input_beg beg, input_end const end)
-{
-    return to_utf16_size(from_utf8_range{beg, end});
-}
+        auto const more = [&] {
+            if constexpr (is_sized)
+                return --available != 0;
+            else
+                return begin != end;
+        };
 
-template <concepts::sized_forward_range_for<char8_t> u8range>
-[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(u8range const &range)
-{
-    return to_utf16_size(from_utf8_range{range});
-}
+        auto last = begin;
+        ::std::uint8_t state = accept;
+        do
+        {
+            last = begin;
+            state = step(state, code_point, *begin);
+            ++begin;
+        } while (state > reject && more());
 
-template <concepts::forward_iterator_for<char8_t> u8beg, ::std::sized_sentinel_for<u8beg> u8end,
-          ::std::output_iterator<char32_t> code_point_out>
-constexpr void to_utf32(u8beg beg, u8end end, code_point_out out)
-{
-    ::std::ranges::copy(from_utf8_range{beg, end}, out);
-}
+        if (state == reject)
+            detail::fail(last, last == start ? error_kind::header_length : error_kind::trail_byte);
+        if (state != accept)
+            detail::fail(start, error_kind::header_length);
 
-template <concepts::forward_iterator_for<char8_t> u8beg, ::std::sized_sentinel_for<u8beg> u8end,
-          ::std::output_iterator<char16_t> code_point_out>
-constexpr void to_utf16(u8beg beg, u8end end, code_point_out out)
-{
-    to_utf32(beg, end, to_utf16_iter{out});
-}
+        return begin;
+    }
 
-template <concepts::sized_input_range_for<char8_t> u8range, ::std::output_iterator<char32_t> code_point_out_iter>
-constexpr void to_utf32(u8range const &range, code_point_out_iter out)
-{
-    from_utf8_range rng{range};
-    to_utf32(::std::ranges::begin(rng), ::std::ranges::end(rng), out);
-}
+    // Decodes a whole buffer for the bulk conversions, Hoehrmann style: the automaton runs over
+    // every byte and a code point goes out each time it is back in accept, so nothing leaves the
+    // loop at a sequence end. A 16 byte chunk met in the accept state that is all ASCII is copied
+    // out as is. Errors are positioned as in run.
+    template <class code_point_out>
+    [[nodiscard]] static constexpr auto decode_stream(char8_t const *pos, char8_t const *const last,
+                                                      code_point_out out) -> code_point_out
+    {
+        ::std::uint8_t state = accept;
+        char32_t code_point = 0;
 
-template <concepts::sized_input_range_for<char8_t> u8range, ::std::output_iterator<char16_t> code_point_out>
-constexpr void to_utf16(u8range const &range, code_point_out out)
-{
-    to_utf16(::std::ranges::begin(range), ::std::ranges::end(range), out);
-}
+        detail::tally counts;
+        counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+        [[maybe_unused]] bool in_ascii = true;
 
-} // namespace unic
+        auto const feed = [&](char8_t const *const byte) {
+            auto const previous = state;
+            state = step(state, code_point, *byte);
+            if (state == reject)
+                detail::fail(byte, previous == accept ? error_kind::header_length : error_kind::trail_byte);
+
+            if constexpr (instrumentation::enabled)
+            {
+                auto const ascii = *byte < 0x80;
+                counts.non_ascii_runs += in_ascii && !ascii;
+                in_ascii = ascii;
+                counts.sequence(1, state == accept ? detail::code_point_units<code_point_out> : 0);
+            }
+
+            if constexpr (::std::is_pointer_v<code_point_out>)
+            {
+                // the slot of the sequence being read holds its partial code point until it is
+                // complete, so where sequences end takes no branch. That slot is the lead byte's,
+                // so count_code_points bounds what is written even on invalid input; storing
+                // only on accept costs a branch or a select per byte.
+                *out = code_point;
+                out += state == accept;
+            }
+            else if (state == accept)
+            {
+                *out = code_point;
+                ++out;
+            }
+        };
+
+        if (!::std::is_constant_evaluated())
+        {
+            while (last - pos >= 16)
+            {
+                if (state == accept && ((detail::load_word(pos) | detail::load_word(pos + 8)) & detail::high_bits) == 0)
+                {
+#if UNIC_SSE2
+                    if constexpr (::std::is_same_v<code_point_out, char32_t *>)
+                    {
+                        auto const zero = _mm_setzero_si128();
+                        auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                        auto const low = _mm_unpacklo_epi8(bytes, zero);
+                        auto const high = _mm_unpackhi_epi8(bytes, zero);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi16(low, zero));
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), _mm_unpackhi_epi16(low, zero));
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpacklo_epi16(high, zero));
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12), _mm_unpackhi_epi16(high, zero));
+                        pos += 16;
+                        out += 16;
+                        counts.block(16, 16);
+                        in_ascii = true;
+                        continue;
+                    }
+#endif
+                    for (int i = 0; i < 16; ++i, ++out)
+                        *out = static_cast<char32_t>(pos[i]);
+                    pos += 16;
+                    counts.block(16, 16 * detail::code_point_units<code_point_out>);
+                    in_ascii = true;
+                    continue;
+                }
+
+                for (auto const stop = pos + 16; pos != stop; ++pos)
+                    feed(pos);
+            }
+        }
+
+        for (; pos != last; ++pos)
+            feed(pos);
+        if (state != accept)
+        {
+            // truncated: the trail bytes read so far were all valid, so the lead is the last non-trail byte
+            while ((*--pos & 0xC0) == 0x80)
+            {
+            }
+            detail::fail(pos, error_kind::header_length);
+        }
+        return out;
+    }
+
+    // Validates with the strict lead table instead of stepping the automaton
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto next(src_iter begin, src_end_iter const &end) -> src_iter
+    {
+        auto const lead = tables::strict_lead[*begin];
+        if (lead.length == 0 || !detail::has_elements(begin, end, lead.length))
+            detail::fail(begin, error_kind::header_length);
+
+        if (lead.length == 1)
+            return ++begin;
+
+        ++begin;
+        if (*begin < lead.second_min || lead.second_max < *begin)
+            detail::fail(begin, error_kind::trail_byte);
+
+        for (int i = 2; i < lead.length; ++i)
+        {
+            ++begin;
+            if (*begin < 0x80 || 0xBF < *begin)
+                detail::fail(begin, error_kind::trail_byte);
+        }
+        return ++begin;
+    }
+
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto decode(src_iter begin, src_end_iter const &end) -> char32_t
+    {
+        char32_t code_point = 0;
+        (void)run(::std::move(begin), end, code_point);
+        return code_point;
+    }
+
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto read(src_iter &begin, src_end_iter const &end) -> char32_t
+    {
+        char32_t code_point = 0;
+        begin = run(::std::move(begin), end, code_point);
+        return code_point;
+    }
+};
+} // namespace engines
+
+namespace concepts
+{
+template <class Engine, class Iter, class End>
+concept utf8_engine_for = requires(Iter const &it, Iter &cursor, End const &end) {
+    { Engine::max_length } -> ::std::convertible_to<int>;
+    { Engine::next(it, end) } -> ::std::same_as<Iter>;
+    { Engine::decode(it, end) } -> ::std::same_as<char32_t>;
+    { Engine::read(cursor, end) } -> ::std::same_as<char32_t>;
+};
+} // namespace concepts
+
+// Sentinel of a null-terminated string: from_utf8_range{str, null_terminator{}}
+struct null_terminator
+{
+    template <::std::input_iterator src_iter>
+    [[nodiscard]] friend constexpr auto operator==(src_iter const &it, null_terminator) -> bool
+    {
+        return *it == ::std::iter_value_t<src_iter>{};
+    }
+};
+
+// utf8 to code points
+// The end may be any sentinel, e.g. null_terminator; end checks are per byte unless it is sized.
+template <concepts::forward_iterator_for<char8_t> src_iter, ::std::sentinel_for<src_iter> src_end_iter,
+          concepts::utf8_engine_for<src_iter, src_end_iter> engine = engines::branchy>
+class from_utf8_range final : public ::std::ranges::view_interface<from_utf8_range<src_iter, src_end_iter, engine>>
+{
+  private:
+    [[no_unique_address]] src_iter m_begin{};
+    [[no_unique_address]] src_end_iter m_end{};
+
+    // Contiguous sources are walked with raw pointers. A sequence starting before the safe end
+    // is complete in memory, so the engine only bounds checks the last (max_length - 1) bytes.
+    // Note that errors then carry a char8_t const * position.
+    static constexpr bool is_contiguous =
+        ::std::contiguous_iterator<src_iter> && ::std::sized_sentinel_for<src_end_iter, src_iter>;
+    static constexpr bool is_common = is_contiguous || ::std::same_as<src_iter, src_end_iter>;
+    static constexpr bool is_bidirectional = ::std::bidirectional_iterator<src_iter>;
+
+    using cursor = ::std::conditional_t<is_contiguous, char8_t const *, src_iter>;
+    using cursor_end = ::std::conditional_t<is_contiguous, char8_t const *, src_end_iter>;
+
+    struct unused
+    {
+    };
+    using safe_end = ::std::conditional_t<is_contiguous, char8_t const *, unused>;
+    using first_cursor = ::std::conditional_t<is_bidirectional, cursor, unused>; // lower bound for stepping back
+
+  public:
+    struct iterator final // forward_iterator, bidirectional_iterator if src_iter is one
+    {
+      private:
+        friend class from_utf8_range;
+
+        [[no_unique_address]] cursor m_begin{};
+        [[no_unique_address]] cursor m_next{}; // past the sequence at m_begin
+        [[no_unique_address]] cursor_end m_end{};
+        [[no_unique_address]] safe_end m_safe_end{};
+        [[no_unique_address]] first_cursor m_first{};
+        char32_t m_value = 0; // the code point of the sequence at m_begin
+
+        // Decodes the sequence the iterator landed on, once: operator* hands out the
+        // code point and operator++ jumps to where the sequence ended
+        constexpr void load()
+        {
+            if (m_begin == m_end)
+                return;
+
+            m_next = m_begin;
+            if constexpr (is_contiguous)
+            {
+                if (m_begin < m_safe_end)
+                    m_value = engine::read(m_next, detail::unbounded_end{});
+                else
+                    m_value = engine::read(m_next, m_end);
+            }
+            else
+                m_value = engine::read(m_next, m_end);
+
+            // the units it yields are counted by the converters writing them out, if any
+            if constexpr (instrumentation::enabled)
+            {
+                detail::tally counts;
+                counts.bytes_in = static_cast<::std::uint64_t>(::std::ranges::distance(m_begin, m_next));
+                counts.sequence(counts.bytes_in, 0);
+            }
+        }
+
+        constexpr iterator(cursor const &first, cursor begin, cursor_end end)
+            : m_begin(::std::move(begin))
+            , m_end(::std::move(end))
+        {
+            if constexpr (is_contiguous)
+                m_safe_end = m_end - first >= engine::max_length - 1 ? m_end - (engine::max_length - 1) : first;
+            if constexpr (is_bidirectional)
+                m_first = first;
+            load();
+        }
+
+      public:
+        constexpr iterator() = default; // required for the iterator concept apparently
+
+        using iterator_category =
+            ::std::conditional_t<is_bidirectional, ::std::bidirectional_iterator_tag, ::std::forward_iterator_tag>;
+        using difference_type = ::std::ptrdiff_t;
+        using value_type = char32_t;
+
+        // Position of the current sequence in the source
+        [[nodiscard]] constexpr auto base() const noexcept -> cursor const & { return m_begin; }
+
+        [[maybe_unused]] constexpr auto operator++() -> iterator &
+        {
+            m_begin = m_next;
+            load();
+            return *this;
+        }
+
+        [[nodiscard]] constexpr auto operator++(int) -> iterator
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        // Steps back over the trail bytes, then checks the lead found there spans exactly up to here
+        [[maybe_unused]] constexpr auto operator--() -> iterator &
+            requires is_bidirectional
+        {
+            auto const old = m_begin;
+            int steps = 0;
+            do
+            {
+                --m_begin;
+                ++steps;
+            } while (m_begin != m_first && steps < engine::max_length && (*m_begin & 0xC0) == 0x80);
+
+            auto next = m_begin;
+            auto const value = engine::read(next, m_end);
+            if (next != old)
+                detail::fail(m_begin, error_kind::header_length);
+
+            m_next = old;
+            m_value = value;
+            return *this;
+        }
+
+        [[nodiscard]] constexpr auto operator--(int) -> iterator
+            requires is_bidirectional
+        {
+            auto copy = *this;
+            --*this;
+            return copy;
+        }
+
+        [[nodiscard]] constexpr auto operator*() const noexcept -> char32_t { return m_value; }
+
+        [[nodiscard]] constexpr auto operator==(iterator const &other) const noexcept -> bool
+        {
+            return m_begin == other.m_begin;
+        }
+
+        [[nodiscard]] constexpr auto operator==(src_end_iter const &end) const -> bool
+            requires(!is_common)
+        {
+            return m_begin == end;
+        }
+    };
+
+  public:
+    using engine_type = engine;
+
+    constexpr from_utf8_range() = default;
+
+    constexpr from_utf8_range(src_iter begin, src_end_iter end) noexcept
+        : m_begin(::std::move(begin))
+        , m_end(::std::move(end))
+    {
+    }
+
+    template <concepts::sized_range_for<char8_t> u8range>
+    constexpr from_utf8_range(u8range const &range) noexcept
+        : from_utf8_range(::std::ranges::begin(range), ::std::ranges::end(range))
+    {
+    }
+
+    // engine selection by tag: from_utf8_range{str, engines::dfa{}}
+    constexpr from_utf8_range(src_iter begin, src_end_iter end, engine) noexcept
+        : from_utf8_range(::std::move(begin), ::std::move(end))
+    {
+    }
+
+    template <concepts::sized_range_for<char8_t> u8range>
+    constexpr from_utf8_range(u8range const &range, engine) noexcept
+        : from_utf8_range(::std::ranges::begin(range), ::std::ranges::end(range))
+    {
+    }
+
+    // all iterators are const. begin() decodes the first sequence, so it throws if that is invalid.
+    [[nodiscard]] constexpr auto begin() const
+    {
+        if constexpr (is_contiguous)
+        {
+            auto const first = ::std::to_address(m_begin);
+            return iterator(first, first, first + (m_end - m_begin));
+        }
+        else
+            return iterator(m_begin, m_begin, m_end);
+    }
+
+    [[nodiscard]] constexpr auto end() const noexcept
+    {
+        if constexpr (is_contiguous)
+        {
+            auto const first = ::std::to_address(m_begin);
+            auto const last = first + (m_end - m_begin);
+            return iterator{first, last, last};
+        }
+        else if constexpr (is_common)
+            return iterator{m_begin, m_end, m_end};
+        else
+            return m_end;
+    }
+
+    [[nodiscard]] constexpr auto cbegin() const { return begin(); }
+    [[nodiscard]] constexpr auto cend() const noexcept { return end(); }
+
+    // The undecoded bytes
+    [[nodiscard]] constexpr auto source() const noexcept { return ::std::ranges::subrange(m_begin, m_end); }
+};
+
+template <concepts::sized_range_for<char8_t> u8range>
+from_utf8_range(u8range const &range) noexcept->from_utf8_range<::std::decay_t<decltype(::std::ranges::begin(range))>,
+                                                                ::std::decay_t<decltype(::std::ranges::end(range))>>;
+
+template <class src_iter, class src_end_iter, class engine>
+from_utf8_range(src_iter, src_end_iter, engine) noexcept->from_utf8_range<src_iter, src_end_iter, engine>;
+
+template <concepts::sized_range_for<char8_t> u8range, class engine>
+from_utf8_range(u8range const &range, engine) noexcept
+    ->from_utf8_range<::std::decay_t<decltype(::std::ranges::begin(range))>,
+                      ::std::decay_t<decltype(::std::ranges::end(range))>, engine>;
+
+// utf8 to code points over a single-pass source, such as a stream or a socket.
+// The current sequence is pulled into a small lookahead buffer and decoded there by the engine.
+// Only as many bytes as the lead byte announces get pulled, so a blocking source is never read
+// ahead of the code point being decoded. Errors carry the offset of the offending byte in the
+// stream as their position. Like any input view it is consumed by iterating it, once.
+template <concepts::byte_input_iterator src_iter, ::std::sentinel_for<src_iter> src_end_iter,
+          concepts::utf8_engine_for<char8_t *, char8_t *> engine = engines::branchy>
+class from_utf8_input_range final
+    : public ::std::ranges::view_interface<from_utf8_input_range<src_iter, src_end_iter, engine>>
+{
+  private:
+    [[no_unique_address]] src_iter m_source{};
+    [[no_unique_address]] src_end_iter m_end{};
+
+    ::std::array<char8_t, 8> m_lookahead{};
+    int m_pending = 0;             // bytes in m_lookahead not decoded yet
+    ::std::ptrdiff_t m_offset = 0; // stream offset of m_lookahead[0]
+    char32_t m_current = 0;
+    bool m_done = false;
+
+    constexpr void pull()
+    {
+        m_lookahead[m_pending++] = static_cast<char8_t>(*m_source);
+        ++m_source;
+    }
+
+    constexpr void fetch()
+    {
+        if (m_pending == 0)
+        {
+            if (m_source == m_end)
+            {
+                m_done = true;
+                return;
+            }
+            pull();
+        }
+
+        auto const announced = tables::header_length[m_lookahead[0]];
+        auto const needed = announced < 1 ? 1 : ::std::min<int>(announced, engine::max_length);
+        while (m_pending < needed && m_source != m_end)
+            pull();
+
+        auto const first = m_lookahead.data();
+        auto pos = first;
+#if UNIC_EXCEPTIONS
+        try
+        {
+            m_current = engine::read(pos, first + m_pending);
+        }
+        catch (utf_positioned_error<char8_t *> const &error)
+        {
+            throw utf_positioned_error<::std::ptrdiff_t>(m_offset + (error.error_position - first), error.what());
+        }
+#else
+        m_current = engine::read(pos, first + m_pending);
+#endif
+
+        auto const used = static_cast<int>(pos - first);
+        ::std::copy(first + used, first + m_pending, first);
+        m_pending -= used;
+        m_offset += used;
+
+        if constexpr (instrumentation::enabled)
+        {
+            detail::tally counts;
+            counts.bytes_in = static_cast<::std::uint64_t>(used);
+            counts.sequence(counts.bytes_in, 0);
+        }
+    }
+
+  public:
+    struct iterator final // input_iterator
+    {
+      private:
+        friend class from_utf8_input_range;
+
+        from_utf8_input_range *m_parent = nullptr;
+
+        constexpr explicit iterator(from_utf8_input_range *parent) noexcept
+            : m_parent(parent)
+        {
+        }
+
+      public:
+        constexpr iterator() = default;
+
+        using iterator_concept = ::std::input_iterator_tag;
+        using difference_type = ::std::ptrdiff_t;
+        using value_type = char32_t;
+
+        [[maybe_unused]] constexpr auto operator++() -> iterator &
+        {
+            m_parent->fetch();
+            return *this;
+        }
+
+        constexpr void operator++(int) { ++*this; }
+
+        [[nodiscard]] constexpr auto operator*() const noexcept -> char32_t { return m_parent->m_current; }
+
+        [[nodiscard]] constexpr auto operator==(::std::default_sentinel_t) const noexcept -> bool
+        {
+            return m_parent->m_done;
+        }
+    };
+
+    constexpr from_utf8_input_range() = default;
+
+    constexpr from_utf8_input_range(src_iter begin, src_end_iter end)
+        : m_source(::std::move(begin))
+        , m_end(::std::move(end))
+    {
+    }
+
+    constexpr from_utf8_input_range(src_iter begin, src_end_iter end, engine)
+        : from_utf8_input_range(::std::move(begin), ::std::move(end))
+    {
+    }
+
+    // Decodes the first code point, call once
+    [[nodiscard]] constexpr auto begin() -> iterator
+    {
+        fetch();
+        return iterator{this};
+    }
+
+    [[nodiscard]] constexpr auto end() const noexcept { return ::std::default_sentinel; }
+};
+
+template <class src_iter, class src_end_iter>
+from_utf8_input_range(src_iter, src_end_iter) -> from_utf8_input_range<src_iter, src_end_iter>;
+
+template <class src_iter, class src_end_iter, class engine>
+from_utf8_input_range(src_iter, src_end_iter, engine) -> from_utf8_input_range<src_iter, src_end_iter, engine>;
+
+// Random access to the code points of a contiguous UTF-8 buffer.
+// On first use, one SWAR pass records the byte offset of every stride-th code point; a query
+// then starts from the nearest checkpoint and walks at most stride code points.
+// Code points are counted by their lead bytes, so the buffer is expected to be valid UTF-8;
+// operator[] still decodes through the engine and reports errors.
+// The index is built lazily through a const member, so sharing one view across threads
+// requires calling size() once beforehand.
+template <concepts::utf8_engine_for<char8_t const *, char8_t const *> engine = engines::branchy>
+class utf8_indexed_view final
+{
+  private:
+    char8_t const *m_first = nullptr;
+    char8_t const *m_last = nullptr;
+    ::std::ptrdiff_t m_stride = 64;
+
+    mutable ::std::vector<::std::ptrdiff_t> m_checkpoints{}; // byte offset of code point i * stride
+    mutable ::std::ptrdiff_t m_size = -1;                    // -1 until indexed
+
+    constexpr void record(char8_t const *const pos, ::std::ptrdiff_t &count, ::std::ptrdiff_t &target) const
+    {
+        if (count == target)
+        {
+            m_checkpoints.push_back(pos - m_first);
+            target += m_stride;
+        }
+        ++count;
+    }
+
+    constexpr void build_index() const
+    {
+        m_checkpoints.clear();
+        ::std::ptrdiff_t count = 0;  // lead bytes before pos
+        ::std::ptrdiff_t target = 0; // next code point to record
+
+        auto pos = m_first;
+        if (!::std::is_constant_evaluated())
+        {
+            for (; m_last - pos >= 8; pos += 8)
+            {
+                auto const leads = detail::count_lead_bytes(detail::load_word(pos));
+                if (count + leads <= target)
+                {
+                    count += leads;
+                    continue;
+                }
+
+                for (int i = 0; i < 8; ++i)
+                {
+                    if (detail::is_lead_byte(pos[i]))
+                        record(pos + i, count, target);
+                }
+            }
+        }
+
+        for (; pos != m_last; ++pos)
+        {
+            if (detail::is_lead_byte(*pos))
+                record(pos, count, target);
+        }
+
+        // so that offset_of(size()) has a checkpoint too
+        if (count == target)
+            m_checkpoints.push_back(m_last - m_first);
+
+        m_size = count;
+    }
+
+    constexpr void ensure_index() const
+    {
+        if (m_size == -1)
+            build_index();
+    }
+
+  public:
+    constexpr utf8_indexed_view() = default;
+
+    // A stride below 1 is rejected: std::invalid_argument is thrown, or without exceptions std::abort called
+    constexpr utf8_indexed_view(char8_t const *const first, char8_t const *const last,
+                                ::std::ptrdiff_t const stride = 64)
+        : m_first(first)
+        , m_last(last)
+        , m_stride(stride)
+    {
+        if (stride <= 0)
+        {
+#if UNIC_EXCEPTIONS
+            throw ::std::invalid_argument("utf8_indexed_view stride must be positive");
+#else
+            ::std::abort();
+#endif
+        }
+    }
+
+    template <concepts::contiguous_range_for<char8_t> u8range>
+    explicit constexpr utf8_indexed_view(u8range const &range, ::std::ptrdiff_t const stride = 64)
+        : utf8_indexed_view(::std::ranges::data(range),
+                            ::std::ranges::data(range) + ::std::ranges::size(range), stride)
+    {
+    }
+
+    // Number of code points
+    [[nodiscard]] constexpr auto size() const -> ::std::ptrdiff_t
+    {
+        ensure_index();
+        return m_size;
+    }
+
+    [[nodiscard]] constexpr auto stride() const noexcept -> ::std::ptrdiff_t { return m_stride; }
+
+    // Byte offset of code point n, 0 <= n <= size()
+    [[nodiscard]] constexpr auto offset_of(::std::ptrdiff_t const n) const -> ::std::ptrdiff_t
+    {
+        ensure_index();
+        auto const checkpoint = m_first + m_checkpoints[static_cast<::std::size_t>(n / m_stride)];
+        return detail::skip_sequences(checkpoint, m_last, n % m_stride) - m_first;
+    }
+
+    // Index of the code point starting at byte offset, offset being on a code point boundary
+    [[nodiscard]] constexpr auto index_of(::std::ptrdiff_t const offset) const -> ::std::ptrdiff_t
+    {
+        ensure_index();
+        auto const after = ::std::ranges::upper_bound(m_checkpoints, offset);
+        auto const checkpoint = ::std::ranges::prev(after);
+        return (checkpoint - m_checkpoints.begin()) * m_stride +
+               detail::count_lead_bytes(m_first + *checkpoint, m_first + offset);
+    }
+
+    // Byte offset n code points away from the code point at byte offset
+    [[nodiscard]] constexpr auto advance(::std::ptrdiff_t const offset, ::std::ptrdiff_t const n) const
+        -> ::std::ptrdiff_t
+    {
+        return offset_of(index_of(offset) + n);
+    }
+
+    // Code points between two byte offsets
+    [[nodiscard]] constexpr auto distance(::std::ptrdiff_t const first_offset, ::std::ptrdiff_t const last_offset) const
+        -> ::std::ptrdiff_t
+    {
+        return index_of(last_offset) - index_of(first_offset);
+    }
+
+    [[nodiscard]] constexpr auto operator[](::std::ptrdiff_t const n) const -> char32_t
+    {
+        return engine::decode(m_first + offset_of(n), m_last);
+    }
+
+    // Throws like from_utf8_range::begin() if the first sequence is invalid
+    [[nodiscard]] constexpr auto begin() const { return from_utf8_range{m_first, m_last, engine{}}.begin(); }
+    [[nodiscard]] constexpr auto end() const noexcept { return from_utf8_range{m_first, m_last, engine{}}.end(); }
+};
+
+template <concepts::contiguous_range_for<char8_t> u8range>
+utf8_indexed_view(u8range const &range, ::std::ptrdiff_t stride = 64) -> utf8_indexed_view<>;
+
+// Units a position in UTF-8 text can be measured in
+enum class text_unit
+{
+    byte,
+    utf16,
+    code_point
+};
+
+struct text_position
+{
+    ::std::ptrdiff_t line = 0;
+    ::std::ptrdiff_t column = 0; // in the unit of the query
+};
+
+// Maps between byte, UTF-16 and code point offsets and (line, column) positions in a
+// contiguous UTF-8 buffer, e.g. for language server positions.
+// Lines end at \n, \r\n or a lone \r. Every line start is marked, as is every point
+// where stride bytes have passed since the last mark; each mark stores the offset in
+// all units. A query is a binary search over the marks plus a walk of at most stride bytes.
+// The buffer is borrowed and decoded with the given engine, so invalid UTF-8 throws.
+template <concepts::utf8_engine_for<char8_t const *, char8_t const *> engine = engines::branchy>
+class utf8_position_index final
+{
+  private:
+    struct mark
+    {
+        ::std::ptrdiff_t byte = 0;
+        ::std::ptrdiff_t utf16 = 0;
+        ::std::ptrdiff_t code_point = 0;
+        ::std::ptrdiff_t line = 0;
+    };
+
+    char8_t const *m_first = nullptr;
+    char8_t const *m_last = nullptr;
+    ::std::ptrdiff_t m_stride = 256;
+    ::std::vector<mark> m_marks{}; // sorted in every member
+
+    [[nodiscard]] static constexpr auto coordinate(mark const &m, text_unit const unit) noexcept -> ::std::ptrdiff_t
+    {
+        switch (unit)
+        {
+        case text_unit::byte:
+            return m.byte;
+        case text_unit::utf16:
+            return m.utf16;
+        default:
+            return m.code_point;
+        }
+    }
+
+    // Last mark at or before value
+    [[nodiscard]] constexpr auto mark_before(::std::ptrdiff_t const value, text_unit const unit) const -> mark const &
+    {
+        auto const after = ::std::ranges::upper_bound(m_marks, value, {},
+                                                      [unit](mark const &m) { return coordinate(m, unit); });
+        return *::std::ranges::prev(after);
+    }
+
+    [[nodiscard]] constexpr auto line_start(::std::ptrdiff_t const line) const -> mark const &
+    {
+        return *::std::ranges::lower_bound(m_marks, line, {}, &mark::line);
+    }
+
+    // Decodes code points from m while the offset in unit stays at or below value
+    [[nodiscard]] constexpr auto walk(mark m, ::std::ptrdiff_t const value, text_unit const unit) const -> mark
+    {
+        from_utf8_range const range{m_first + m.byte, m_last, engine{}};
+        for (auto it = range.begin(); it != range.end() && coordinate(m, unit) < value;)
+        {
+            auto const code_point = *it;
+            auto const sequence = it.base();
+            ++it;
+
+            auto next = m;
+            next.byte += it.base() - sequence;
+            next.utf16 += code_point > 0xFFFF ? 2 : 1;
+            next.code_point += 1;
+            if (coordinate(next, unit) > value) // value points into a surrogate pair
+                break;
+            m = next;
+        }
+        return m;
+    }
+
+    // Marks for [m.byte, stop) of the text [first, last), m being a line start
+    [[nodiscard]] constexpr auto scan(char8_t const *const first, char8_t const *const last, mark m,
+                                      char8_t const *const stop) const -> ::std::vector<mark>
+    {
+        ::std::vector<mark> marks{m};
+        auto last_mark = m.byte;
+
+        from_utf8_range const range{first + m.byte, stop, engine{}};
+        for (auto it = range.begin(); it != range.end();)
+        {
+            auto const code_point = *it;
+            auto const sequence = it.base();
+            ++it;
+
+            m.byte += it.base() - sequence;
+            m.utf16 += code_point > 0xFFFF ? 2 : 1;
+            m.code_point += 1;
+
+            if (code_point == U'\n' || (code_point == U'\r' && (it.base() == last || *it.base() != u8'\n')))
+            {
+                ++m.line;
+                marks.push_back(m);
+                last_mark = m.byte;
+            }
+            else if (m.byte - last_mark >= m_stride)
+            {
+                marks.push_back(m);
+                last_mark = m.byte;
+            }
+        }
+        return marks;
+    }
+
+  public:
+    template <concepts::contiguous_range_for<char8_t> u8range>
+    explicit constexpr utf8_position_index(u8range const &text, ::std::ptrdiff_t const stride = 256)
+        : m_first(::std::ranges::data(text))
+        , m_last(::std::ranges::data(text) + ::std::ranges::size(text))
+        , m_stride(stride)
+        , m_marks(scan(m_first, m_last, mark{}, m_last))
+    {
+    }
+
+    [[nodiscard]] constexpr auto line_count() const noexcept -> ::std::ptrdiff_t { return m_marks.back().line + 1; }
+
+    // Offset in one unit to the offset of the same point in another
+    [[nodiscard]] constexpr auto convert(::std::ptrdiff_t const value, text_unit const from, text_unit const to) const
+        -> ::std::ptrdiff_t
+    {
+        return coordinate(walk(mark_before(value, from), value, from), to);
+    }
+
+    // Offset to (line, column), the column being measured in the same unit
+    [[nodiscard]] constexpr auto position_of(::std::ptrdiff_t const value, text_unit const unit) const
+        -> text_position
+    {
+        auto const m = walk(mark_before(value, unit), value, unit);
+        return {m.line, coordinate(m, unit) - coordinate(line_start(m.line), unit)};
+    }
+
+    // (line, column) to offset, the column being measured in the same unit
+    [[nodiscard]] constexpr auto offset_of(text_position const pos, text_unit const unit) const -> ::std::ptrdiff_t
+    {
+        return coordinate(line_start(pos.line), unit) + pos.column;
+    }
+
+    // Updates the index after [first_byte, first_byte + removed) of the old buffer got
+    // replaced by inserted bytes; text is the buffer after the edit.
+    // Only the lines touching the edit are decoded again, later marks are shifted.
+    // If the edited lines don't decode, the error propagates and the index is left as it was.
+    template <concepts::contiguous_range_for<char8_t> u8range>
+    constexpr void apply_edit(u8range const &text, ::std::ptrdiff_t const first_byte, ::std::ptrdiff_t const removed,
+                              ::std::ptrdiff_t const inserted)
+    {
+        // Rescan from a line start strictly before the edit and up to one strictly after it,
+        // so a \r\n pair can't get split or joined at either boundary unnoticed
+        auto const by_byte = [](mark const &m) { return m.byte; };
+        auto const is_line_start = [this](auto const it) {
+            return it == m_marks.begin() || ::std::ranges::prev(it)->line != it->line;
+        };
+
+        auto first = ::std::ranges::lower_bound(m_marks, first_byte, {}, by_byte);
+        while (first != m_marks.begin() &&
+               (first == m_marks.end() || first->byte >= first_byte || !is_line_start(first)))
+            --first;
+
+        auto last = ::std::ranges::upper_bound(m_marks, first_byte + removed, {}, by_byte);
+        while (last != m_marks.end() && !is_line_start(last))
+            ++last;
+
+        auto const start = *first;
+        auto const has_tail = last != m_marks.end();
+        auto const old_stop = has_tail ? *last : mark{};
+
+        // everything that can throw happens before m_marks is touched
+        auto const new_first = ::std::ranges::data(text);
+        auto const new_last = new_first + ::std::ranges::size(text);
+        auto const shift = inserted - removed;
+        auto marks = scan(new_first, new_last, start, has_tail ? new_first + old_stop.byte + shift : new_last);
+        if (has_tail)
+        {
+            // the scan ends at the old tail's first line start, pop the mark it made there
+            auto const new_stop = marks.back();
+            marks.pop_back();
+            for (auto m : ::std::ranges::subrange(last, m_marks.end()))
+            {
+                m.byte += new_stop.byte - old_stop.byte;
+                m.utf16 += new_stop.utf16 - old_stop.utf16;
+                m.code_point += new_stop.code_point - old_stop.code_point;
+                m.line += new_stop.line - old_stop.line;
+                marks.push_back(m);
+            }
+        }
+
+        auto const kept = static_cast<::std::size_t>(first - m_marks.begin());
+        m_marks.reserve(kept + marks.size());
+        m_marks.resize(kept); // within capacity from here on, so nothing below throws
+        m_marks.insert(m_marks.end(), marks.begin(), marks.end());
+        m_first = new_first;
+        m_last = new_last;
+    }
+};
+
+// What line_index treats as a line break
+enum class line_breaks
+{
+    ascii,  // \n (and so \r\n)
+    unicode // also a lone \r, NEL (U+0085), LS (U+2028) and PS (U+2029)
+};
+
+// Byte offsets of the line starts of a contiguous UTF-8 buffer.
+// The buffer is scanned once, a word at a time, looking at single bytes only in words
+// holding a byte a break can start with. Line starts are stored as LEB128 deltas in blocks of block_lines lines
+// with an absolute offset per block, so a lookup in either direction is a binary search
+// over the blocks plus the decoding of at most block_lines deltas.
+class line_index final
+{
+  private:
+    static constexpr ::std::ptrdiff_t block_lines = 64;
+
+    struct block
+    {
+        ::std::ptrdiff_t offset = 0; // of the block's first line
+        ::std::size_t stream = 0;    // position of the block's first delta
+    };
+
+    ::std::vector<block> m_blocks{};
+    ::std::vector<::std::uint8_t> m_deltas{};
+    ::std::ptrdiff_t m_lines = 0;
+    ::std::ptrdiff_t m_last_start = 0;
+
+    constexpr void add_line(::std::ptrdiff_t const start)
+    {
+        if (m_lines % block_lines == 0)
+        {
+            m_blocks.push_back({start, m_deltas.size()});
+        }
+        else
+        {
+            auto delta = static_cast<::std::uint64_t>(start - m_last_start);
+            for (; delta >= 0x80; delta >>= 7)
+                m_deltas.push_back(static_cast<::std::uint8_t>(delta | 0x80));
+            m_deltas.push_back(static_cast<::std::uint8_t>(delta));
+        }
+        m_last_start = start;
+        ++m_lines;
+    }
+
+    [[nodiscard]] constexpr auto read_delta(::std::size_t &stream) const noexcept -> ::std::ptrdiff_t
+    {
+        ::std::uint64_t delta = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            auto const byte = m_deltas[stream++];
+            delta |= static_cast<::std::uint64_t>(byte & 0x7F) << shift;
+            if (byte < 0x80)
+                return static_cast<::std::ptrdiff_t>(delta);
+        }
+    }
+
+    // Length of the break starting at pos, 0 if there is none there
+    [[nodiscard]] static constexpr auto break_length(char8_t const *const pos, char8_t const *const last,
+                                                     line_breaks const breaks) noexcept -> int
+    {
+        auto const byte = *pos;
+        if (byte == u8'\n')
+            return 1;
+        if (breaks == line_breaks::ascii)
+            return 0;
+
+        auto const available = last - pos;
+        if (byte == u8'\r') // \r\n is counted at its \n
+            return available == 1 || pos[1] != u8'\n' ? 1 : 0;
+        if (byte == 0xC2) // NEL
+            return available >= 2 && pos[1] == 0x85 ? 2 : 0;
+        if (byte == 0xE2) // LS, PS
+            return available >= 3 && pos[1] == 0x80 && (pos[2] == 0xA8 || pos[2] == 0xA9) ? 3 : 0;
+        return 0;
+    }
+
+  public:
+    constexpr line_index() = default;
+
+    template <concepts::contiguous_range_for<char8_t> u8range>
+    explicit constexpr line_index(u8range const &text, line_breaks const breaks = line_breaks::ascii)
+    {
+        auto const first = ::std::ranges::data(text);
+        auto const last = first + ::std::ranges::size(text);
+
+        add_line(0);
+        auto pos = first;
+        if (!::std::is_constant_evaluated())
+        {
+            for (; last - pos >= 8; pos += 8)
+            {
+                auto const word = detail::load_word(pos);
+                auto candidates = detail::match_byte(word, u8'\n');
+                if (breaks == line_breaks::unicode)
+                {
+                    candidates |= detail::match_byte(word, u8'\r') | detail::match_byte(word, 0xC2) |
+                                  detail::match_byte(word, 0xE2);
+                }
+                if (candidates == 0)
+                    continue;
+
+                for (int i = 0; i < 8; ++i)
+                {
+                    if (auto const length = break_length(pos + i, last, breaks))
+                        add_line(pos + i + length - first);
+                }
+            }
+        }
+
+        for (; pos != last; ++pos)
+        {
+            if (auto const length = break_length(pos, last, breaks))
+                add_line(pos + length - first);
+        }
+    }
+
+    // Number of lines, a trailing break starts an empty last line
+    [[nodiscard]] constexpr auto size() const noexcept -> ::std::ptrdiff_t { return m_lines; }
+
+    // Byte offset of the first byte of line, 0 <= line < size()
+    [[nodiscard]] constexpr auto line_start(::std::ptrdiff_t const line) const noexcept -> ::std::ptrdiff_t
+    {
+        auto const &blk = m_blocks[static_cast<::std::size_t>(line / block_lines)];
+        auto offset = blk.offset;
+        auto stream = blk.stream;
+        for (auto i = line % block_lines; i != 0; --i)
+            offset += read_delta(stream);
+        return offset;
+    }
+
+    // Line the byte at offset belongs to
+    [[nodiscard]] constexpr auto line_of(::std::ptrdiff_t const offset) const noexcept -> ::std::ptrdiff_t
+    {
+        auto const after = ::std::ranges::upper_bound(m_blocks, offset, {}, &block::offset);
+        auto const blk = ::std::ranges::prev(after);
+
+        auto line = (blk - m_blocks.begin()) * block_lines;
+        auto const block_end = ::std::min(line + block_lines, m_lines);
+        auto start = blk->offset;
+        auto stream = blk->stream;
+        for (; line + 1 < block_end; ++line)
+        {
+            start += read_delta(stream);
+            if (start > offset)
+                break;
+        }
+        return line;
+    }
+};
+
+// Number of code points in contiguous UTF-8, counted as the bytes that aren't trail bytes.
+// Doesn't validate; runs at memory bandwidth.
+template <concepts::contiguous_range_for<char8_t> u8range>
+[[nodiscard]] constexpr auto count_code_points(u8range const &range) noexcept -> ::std::ptrdiff_t
+{
+    auto const first = ::std::ranges::data(range);
+    return detail::count_lead_bytes(first, first + ::std::ranges::size(range));
+}
+
+// Validating variant, steps through every sequence with the given engine and throws like
+// from_utf8_range would. Whole ASCII words are skipped without stepping.
+template <concepts::contiguous_range_for<char8_t> u8range,
+          concepts::utf8_engine_for<char8_t const *, char8_t const *> engine>
+[[nodiscard]] constexpr auto count_code_points(u8range const &range, engine) -> ::std::ptrdiff_t
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+    auto const safe_end = last - pos >= engine::max_length - 1 ? last - (engine::max_length - 1) : pos;
+
+    ::std::ptrdiff_t count = 0;
+    if (!::std::is_constant_evaluated())
+    {
+        while (last - pos >= 8)
+        {
+            if ((detail::load_word(pos) & detail::high_bits) == 0)
+            {
+                pos += 8;
+                count += 8;
+                continue;
+            }
+
+            // one word worth of bytes, finishing the sequence that crosses its end
+            for (auto const word_end = pos + 8; pos < word_end; ++count)
+                pos = pos < safe_end ? engine::next(pos, detail::unbounded_end{}) : engine::next(pos, last);
+        }
+    }
+
+    for (; pos != last; ++count)
+        pos = engine::next(pos, last);
+    return count;
+}
+
+// Longest prefix of at most max_bytes bytes that ends on a code point boundary, empty when
+// max_bytes isn't positive. Looks at no more than the 4 bytes around the cut.
+template <concepts::contiguous_range_for<char8_t> u8range>
+[[nodiscard]] constexpr auto truncate_utf8(u8range const &range, ::std::ptrdiff_t const max_bytes) noexcept
+    -> ::std::u8string_view
+{
+    auto const first = ::std::ranges::data(range);
+    if (max_bytes <= 0)
+        return {first, 0};
+
+    auto const size = static_cast<::std::ptrdiff_t>(::std::ranges::size(range));
+    if (size <= max_bytes)
+        return {first, static_cast<::std::size_t>(size)};
+
+    // step back from the cut over the (at most 3) trail bytes of the sequence it splits
+    auto cut = max_bytes;
+    for (int steps = 0; cut > 0 && steps < 3 && !detail::is_lead_byte(first[cut]); ++steps)
+        --cut;
+    return {first, static_cast<::std::size_t>(cut)};
+}
+
+// Longest prefix that ends on a code point boundary and takes at most max_units UTF-16 units,
+// empty when max_units isn't positive. Walks forward no further than the prefix, skipping whole ASCII words.
+template <concepts::contiguous_range_for<char8_t> u8range>
+[[nodiscard]] constexpr auto utf16_prefix_fitting(u8range const &range, ::std::ptrdiff_t const max_units) noexcept
+    -> ::std::u8string_view
+{
+    auto const first = ::std::ranges::data(range);
+    auto const last = first + ::std::ranges::size(range);
+    if (last - first <= max_units) // never more units than bytes
+        return {first, last};
+
+    auto pos = first;
+    ::std::ptrdiff_t units = 0;
+    if (!::std::is_constant_evaluated())
+    {
+        while (last - pos >= 8 && units + 8 <= max_units && (detail::load_word(pos) & detail::high_bits) == 0)
+        {
+            pos += 8;
+            units += 8;
+        }
+    }
+
+    while (pos != last)
+    {
+        auto const needed = *pos >= 0xF0 ? 2 : 1; // 4 byte sequences take a surrogate pair
+        if (units + needed > max_units)
+            break;
+
+        units += needed;
+        do
+            ++pos;
+        while (pos != last && !detail::is_lead_byte(*pos));
+    }
+    return {first, pos};
+}
+
+// Code points to utf16
+template <::std::output_iterator<char16_t> out_iter>
+class to_utf16_iter final
+{
+  private:
+    [[no_unique_address]] out_iter m_iter{};
+
+    // Outputs a code-point to a UTF-16 output iterator
+    constexpr void append(char32_t code_point)
+    {
+        if constexpr (instrumentation::enabled)
+        {
+            detail::tally counts;
+            counts.units_out = code_point <= 0xFFFF ? 1 : code_point <= 0x10FFFF ? 2 : 0;
+        }
+
+        if (code_point <= 0xFFFF)
+        {
+            *m_iter++ = static_cast<char16_t>(code_point);
+        }
+        else if (code_point <= 0x10FFFF)
+        {
+            code_point -= 0x10000;
+            *m_iter++ = static_cast<char16_t>((code_point >> 10) + 0xD800);
+            *m_iter++ = static_cast<char16_t>((code_point & 0x3FF) + 0xDC00);
+        }
+        else
+        {
+            detail::fail(m_iter, error_kind::out_of_utf16_range);
+        }
+    }
+
+    struct proxy_assigner
+    {
+      private:
+        friend class to_utf16_iter;
+        [[no_unique_address]] to_utf16_iter *m_parent;
+
+        constexpr proxy_assigner(to_utf16_iter *parent) noexcept
+            : m_parent{parent}
+        {
+        }
+
+        proxy_assigner(::std::nullptr_t) = delete;
+
+      public:
+        [[maybe_unused]] constexpr auto operator=(char32_t const code_point) const -> proxy_assigner const &
+        {
+            m_parent->append(code_point);
+            return *this;
+        }
+
+        template <class T>
+        proxy_assigner &operator=(T) const = delete;
+    };
+
+  public:
+    constexpr to_utf16_iter(out_iter iter) noexcept
+        : m_iter(::std::move(iter))
+    {
+    }
+
+    constexpr to_utf16_iter() = default;
+
+    using iterator_category = ::std::output_iterator_tag;
+    using difference_type = ::std::ptrdiff_t;
+
+    // Incrementing is no-op for output iterators. Actual incrementing is done on
+    // write
+    [[maybe_unused]] constexpr auto operator++() noexcept -> to_utf16_iter & { return *this; }
+    [[nodiscard]] constexpr auto operator++(int) noexcept -> to_utf16_iter { return *this; }
+
+    [[nodiscard]] constexpr auto operator*() noexcept -> proxy_assigner { return {this}; }
+
+    // The underlying iterator, past the last unit written
+    [[nodiscard]] constexpr auto base() const -> out_iter { return m_iter; }
+};
+
+namespace detail
+{
+template <class out_iter>
+inline constexpr ::std::uint64_t code_point_units<to_utf16_iter<out_iter>> = 0;
+
+#if UNIC_SSE2
+// Bit mask of the 4 code points in v that are above limit, as an unsigned compare
+[[nodiscard]] inline auto above(__m128i const v, ::std::uint32_t const limit) noexcept -> int
+{
+    auto const flip = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    auto const bound = _mm_set1_epi32(static_cast<int>(limit ^ 0x80000000u));
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_xor_si128(v, flip), bound)));
+}
+#endif
+
+// utf32 to utf16 over a contiguous buffer, returns the output past the last unit.
+// Into a char16_t buffer, 8 code points at a time: one compare tells whether all of them are in the BMP,
+// and if so they are narrowed with a single pack. Only the blocks that hold supplementary code points,
+// or invalid ones, go through the scalar loop, which expands surrogate pairs and rejects the rest.
+template <class unit_out>
+constexpr auto encode_utf16_contiguous(char32_t const *pos, char32_t const *const last, unit_out out) -> unit_out
+{
+    tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos) * 4;
+
+    auto const put = [&](char32_t const *const it) {
+        auto const code_point = *it;
+        if (code_point <= 0xFFFF)
+        {
+            *out = static_cast<char16_t>(code_point);
+            ++out;
+            counts.sequence(4, 1);
+        }
+        else if (code_point <= 0x10FFFF)
+        {
+            *out = static_cast<char16_t>(((code_point - 0x10000) >> 10) + 0xD800);
+            ++out;
+            *out = static_cast<char16_t>(((code_point - 0x10000) & 0x3FF) + 0xDC00);
+            ++out;
+            counts.sequence(4, 2);
+        }
+        else
+            fail(it, error_kind::out_of_utf16_range);
+    };
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<unit_out, char16_t *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            // packs saturate as signed, so the values are biased into the signed range and back
+            auto const bias32 = _mm_set1_epi32(0x8000);
+            auto const bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+            for (; last - pos >= 8; pos += 8)
+            {
+                auto const low = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                auto const high = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos + 4));
+                if ((above(low, 0xFFFF) | above(high, 0xFFFF)) == 0)
+                {
+                    auto const packed = _mm_packs_epi32(_mm_sub_epi32(low, bias32), _mm_sub_epi32(high, bias32));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_add_epi16(packed, bias16));
+                    out += 8;
+                    counts.block(32, 8);
+                }
+                else
+                {
+                    for (int i = 0; i < 8; ++i)
+                        put(pos + i);
+                }
+            }
+        }
+    }
+#endif
+
+    for (; pos != last; ++pos)
+        put(pos);
+    return out;
+}
+
+// Units utf16 takes for a contiguous utf32 buffer: each code point plus one per supplementary one
+[[nodiscard]] inline auto utf16_size_contiguous(char32_t const *pos, char32_t const *const last) -> ::std::ptrdiff_t
+{
+    ::std::ptrdiff_t size = last - pos;
+#if UNIC_SSE2
+    for (; last - pos >= 4; pos += 4)
+    {
+        auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+        if (above(v, 0x10FFFF) != 0)
+            break; // the scalar loop finds which one
+        size += ::std::popcount(static_cast<unsigned>(above(v, 0xFFFF)));
+    }
+#endif
+    for (; pos != last; ++pos)
+    {
+        if (*pos > 0x10FFFF)
+            fail(pos, error_kind::out_of_utf16_range);
+        size += *pos > 0xFFFF;
+    }
+    return size;
+}
+} // namespace detail
+
+// Code points above U+10FFFF throw, positioned at the code point as an input_beg
+template <concepts::input_iterator_for<char32_t> input_beg, ::std::sentinel_for<input_beg> input_end>
+[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(input_beg beg, input_end const end)
+{
+    if constexpr (::std::contiguous_iterator<input_beg> && ::std::sized_sentinel_for<input_end, input_beg>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            char32_t const *const first = ::std::to_address(beg);
+            return detail::caller_positioned(
+                beg, first, [&] { return detail::utf16_size_contiguous(first, first + (end - beg)); });
+        }
+    }
+
+    ::std::ptrdiff_t size = 0;
+
+    for (; beg != end; ++beg)
+    {
+        auto const code_point = *beg;
+        if (code_point <= 0xFFFF)
+            size += 1;
+        else if (code_point <= 0x10FFFF)
+            size += 2;
+        else
+            detail::fail(beg, error_kind::out_of_utf16_range);
+    }
+
+    return size;
+}
+
+template <concepts::input_range_for<char32_t> u32range>
+[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(u32range const &range)
+{
+    return to_utf16_size(::std::ranges::begin(range), ::std::ranges::end(range));
+}
+
+// Invalid UTF-8 throws, positioned at the offending byte as an input_beg
+template <concepts::forward_iterator_for<char8_t> input_beg, ::std::sentinel_for<input_beg> input_end>
+[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(input_beg beg, input_end const end)
+{
+    if constexpr (::std::contiguous_iterator<input_beg> && ::std::sized_sentinel_for<input_end, input_beg>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            char8_t const *const first = ::std::to_address(beg);
+            return detail::caller_positioned(
+                beg, first, [&] { return to_utf16_size(from_utf8_range{first, first + (end - beg)}); });
+        }
+    }
+    return to_utf16_size(from_utf8_range{beg, end});
+}
+
+template <concepts::sized_forward_range_for<char8_t> u8range>
+[[nodiscard]] constexpr ::std::ptrdiff_t to_utf16_size(u8range const &range)
+{
+    return to_utf16_size(::std::ranges::begin(range), ::std::ranges::end(range));
+}
+
+// Paths one bulk conversion took, for tuning data toward the fast ones. A block is 8 bytes of ASCII,
+// 8 bytes of 2 byte sequences or 6 bytes of 3 byte sequences; whatever fits none of them is decoded
+// a sequence at a time by the generic path. An error ends the call with errors set to 1.
+// Without exceptions the error path aborts before it can be recorded.
+struct conversion_profile
+{
+    ::std::uint64_t ascii_blocks = 0;
+    ::std::uint64_t two_byte_blocks = 0;
+    ::std::uint64_t three_byte_blocks = 0;
+    ::std::uint64_t generic_sequences = 0;
+    ::std::uint64_t errors = 0;
+};
+
+namespace detail
+{
+// 4 complete 2 byte sequences, none of them overlong
+template <class byte_ptr>
+[[nodiscard]] constexpr auto is_two_byte_block(byte_ptr const p) noexcept -> bool
+{
+    bool valid = true;
+    for (int i = 0; i < 8; i += 2)
+        valid &= (p[i] & 0xE0) == 0xC0 && p[i] >= 0xC2 && (p[i + 1] & 0xC0) == 0x80;
+    return valid;
+}
+
+// 2 complete 3 byte sequences that are neither overlong nor surrogates, so any engine takes them
+template <class byte_ptr>
+[[nodiscard]] constexpr auto is_three_byte_block(byte_ptr const p) noexcept -> bool
+{
+    bool valid = true;
+    for (int i = 0; i < 6; i += 3)
+        valid &= (p[i] & 0xF0) == 0xE0 && p[i] != 0xE0 && p[i] != 0xED && (p[i + 1] & 0xC0) == 0x80 &&
+                 (p[i + 2] & 0xC0) == 0x80;
+    return valid;
+}
+
+// Bulk decoder of contiguous UTF-8. Whole ASCII words go out 8 code points at a time and blocks of
+// Cyrillic-like or CJK-like text without per-sequence checks; everything else goes a sequence at a
+// time through the given engine, unbounded in the safe zone like from_utf8_range.
+template <class engine, bool profiled, class byte_ptr, class code_point_out>
+constexpr auto decode_contiguous(byte_ptr pos, byte_ptr const last, code_point_out out,
+                                 [[maybe_unused]] conversion_profile *const profile = nullptr) -> code_point_out
+{
+    tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+
+    auto const safe_end = last - pos >= engine::max_length - 1 ? last - (engine::max_length - 1) : pos;
+    [[maybe_unused]] bool in_ascii = true;
+
+    while (pos != last)
+    {
+        if (last - pos >= 8)
+        {
+            if ((load_word(::std::to_address(pos)) & high_bits) == 0)
+            {
+                for (int i = 0; i < 8; ++i, ++out)
+                    *out = static_cast<char32_t>(pos[i]);
+                pos += 8;
+
+                if constexpr (profiled)
+                    ++profile->ascii_blocks;
+                if constexpr (instrumentation::enabled)
+                {
+                    counts.fast_path_bytes += 8;
+                    counts.units_out += 8 * code_point_units<code_point_out>;
+                    in_ascii = true;
+                }
+                continue;
+            }
+
+            if (is_two_byte_block(pos))
+            {
+                for (int i = 0; i < 8; i += 2, ++out)
+                    *out = static_cast<char32_t>((pos[i] & 0x1F) << 6 | (pos[i + 1] & 0x3F));
+                pos += 8;
+
+                if constexpr (profiled)
+                    ++profile->two_byte_blocks;
+                if constexpr (instrumentation::enabled)
+                {
+                    counts.non_ascii_runs += in_ascii;
+                    in_ascii = false;
+                    counts.fast_path_bytes += 8;
+                    counts.units_out += 4 * code_point_units<code_point_out>;
+                }
+                continue;
+            }
+
+            if (is_three_byte_block(pos))
+            {
+                for (int i = 0; i < 6; i += 3, ++out)
+                    *out = static_cast<char32_t>((pos[i] & 0x0F) << 12 | (pos[i + 1] & 0x3F) << 6 |
+                                                 (pos[i + 2] & 0x3F));
+                pos += 6;
+
+                if constexpr (profiled)
+                    ++profile->three_byte_blocks;
+                if constexpr (instrumentation::enabled)
+                {
+                    counts.non_ascii_runs += in_ascii;
+                    in_ascii = false;
+                    counts.fast_path_bytes += 6;
+                    counts.units_out += 2 * code_point_units<code_point_out>;
+                }
+                continue;
+            }
+        }
+
+        [[maybe_unused]] auto const start = pos;
+        auto const read_one = [&] {
+            return pos < safe_end ? engine::read(pos, unbounded_end{}) : engine::read(pos, last);
+        };
+
+        if constexpr (profiled)
+            ++profile->generic_sequences;
+#if UNIC_EXCEPTIONS
+        if constexpr (profiled)
+        {
+            try
+            {
+                *out = read_one();
+            }
+            catch (...)
+            {
+                profile->errors = 1;
+                throw;
+            }
+        }
+        else
+            *out = read_one();
+#else
+        *out = read_one();
+#endif
+        ++out;
+
+        if constexpr (instrumentation::enabled)
+        {
+            auto const ascii = *start < 0x80;
+            counts.non_ascii_runs += in_ascii && !ascii;
+            in_ascii = ascii;
+            counts.slow_path_bytes += static_cast<::std::uint64_t>(pos - start);
+            counts.units_out += code_point_units<code_point_out>;
+        }
+    }
+    return out;
+}
+
+// Copies the code points a decoding view yields to out. Only the copying is tallied here, the view
+// counts the bytes it decodes.
+template <class decoded_range, class code_point_out>
+constexpr void copy_decoded(decoded_range &&decoded, code_point_out out)
+{
+    if constexpr (instrumentation::enabled)
+    {
+        tally counts;
+        bool in_ascii = true;
+        for (char32_t const code_point : decoded)
+        {
+            *out = code_point;
+            ++out;
+
+            auto const ascii = code_point < 0x80;
+            counts.non_ascii_runs += in_ascii && !ascii;
+            in_ascii = ascii;
+            counts.units_out += code_point_units<code_point_out>;
+        }
+    }
+    else
+        ::std::ranges::copy(decoded, ::std::move(out));
+}
+} // namespace detail
+
+// Invalid UTF-8 throws, positioned at the offending byte as a u8beg; to_utf16 likewise
+template <concepts::forward_iterator_for<char8_t> u8beg, ::std::sentinel_for<u8beg> u8end,
+          ::std::output_iterator<char32_t> code_point_out>
+constexpr void to_utf32(u8beg beg, u8end end, code_point_out out)
+{
+    if constexpr (::std::contiguous_iterator<u8beg> && ::std::sized_sentinel_for<u8end, u8beg>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            char8_t const *const first = ::std::to_address(beg);
+            detail::caller_positioned(beg, first, [&] {
+                detail::decode_contiguous<engines::branchy, false>(first, first + (end - beg), ::std::move(out));
+            });
+            return;
+        }
+    }
+    detail::copy_decoded(from_utf8_range{beg, end}, ::std::move(out));
+}
+
+// Null-terminated strings are decoded and searched for the terminator in the same pass.
+// Aligned words that are all ASCII and hold no terminator go out 8 code points at a time;
+// an aligned word never crosses a page, so reading one past the terminator can't fault.
+// Takes mutable and const pointers alike, errors are positioned at the pointer type given.
+template <class byte_ptr, ::std::output_iterator<char32_t> code_point_out>
+    requires(::std::is_pointer_v<byte_ptr> &&
+             ::std::is_same_v<::std::remove_cv_t<::std::remove_pointer_t<byte_ptr>>, char8_t>)
+constexpr void to_utf32(byte_ptr str, null_terminator const end, code_point_out out)
+{
+#if UNIC_ALIGNED_OVERREAD
+    if (!::std::is_constant_evaluated())
+    {
+        detail::tally counts;
+        [[maybe_unused]] bool in_ascii = true;
+        for (;;)
+        {
+            if (reinterpret_cast<::std::uintptr_t>(str) % 8 == 0)
+            {
+                auto const word = detail::load_word(str);
+                if ((word & detail::high_bits) == 0 && detail::match_byte(word, 0) == 0)
+                {
+                    for (int i = 0; i < 8; ++i, ++out)
+                        *out = static_cast<char32_t>(str[i]);
+                    str += 8;
+
+                    if constexpr (instrumentation::enabled)
+                    {
+                        counts.bytes_in += 8;
+                        counts.fast_path_bytes += 8;
+                        counts.units_out += 8 * detail::code_point_units<code_point_out>;
+                        in_ascii = true;
+                    }
+                    continue;
+                }
+            }
+
+            if (*str == 0)
+                return;
+            [[maybe_unused]] auto const start = str;
+            *out = engines::branchy::read(str, end);
+            ++out;
+
+            if constexpr (instrumentation::enabled)
+            {
+                auto const ascii = *start < 0x80;
+                counts.non_ascii_runs += in_ascii && !ascii;
+                in_ascii = ascii;
+                counts.bytes_in += static_cast<::std::uint64_t>(str - start);
+                counts.slow_path_bytes += static_cast<::std::uint64_t>(str - start);
+                counts.units_out += detail::code_point_units<code_point_out>;
+            }
+        }
+    }
+#endif
+    detail::copy_decoded(from_utf8_range{str, end}, ::std::move(out));
+}
+
+template <concepts::forward_iterator_for<char8_t> u8beg, ::std::sentinel_for<u8beg> u8end,
+          ::std::output_iterator<char16_t> code_point_out>
+constexpr void to_utf16(u8beg beg, u8end end, code_point_out out)
+{
+    to_utf32(beg, end, to_utf16_iter{out});
+}
+
+// Single-pass sources decode through from_utf8_input_range, without buffering the input
+template <concepts::byte_input_iterator u8beg, ::std::sentinel_for<u8beg> u8end,
+          ::std::output_iterator<char32_t> code_point_out>
+    requires(!::std::forward_iterator<u8beg>)
+constexpr void to_utf32(u8beg beg, u8end end, code_point_out out)
+{
+    detail::copy_decoded(from_utf8_input_range{::std::move(beg), ::std::move(end)}, ::std::move(out));
+}
+
+template <concepts::byte_input_iterator u8beg, ::std::sentinel_for<u8beg> u8end,
+          ::std::output_iterator<char16_t> code_point_out>
+    requires(!::std::forward_iterator<u8beg>)
+constexpr void to_utf16(u8beg beg, u8end end, code_point_out out)
+{
+    to_utf32(::std::move(beg), ::std::move(end), to_utf16_iter{out});
+}
+
+template <concepts::sized_input_range_for<char8_t> u8range, ::std::output_iterator<char32_t> code_point_out_iter>
+constexpr void to_utf32(u8range const &range, code_point_out_iter out)
+{
+    to_utf32(::std::ranges::begin(range), ::std::ranges::end(range), out);
+}
+
+template <concepts::sized_input_range_for<char8_t> u8range, ::std::output_iterator<char16_t> code_point_out>
+constexpr void to_utf16(u8range const &range, code_point_out out)
+{
+    to_utf16(::std::ranges::begin(range), ::std::ranges::end(range), out);
+}
+
+// Profiled variants, profile receives the paths this call took
+template <concepts::contiguous_range_for<char8_t> u8range, ::std::output_iterator<char32_t> code_point_out>
+void to_utf32(u8range const &range, code_point_out out, conversion_profile &profile)
+{
+    profile = {};
+    auto const first = ::std::ranges::data(range);
+    detail::decode_contiguous<engines::branchy, true>(first, first + ::std::ranges::size(range), ::std::move(out),
+                                                      &profile);
+}
+
+template <concepts::contiguous_range_for<char8_t> u8range, ::std::output_iterator<char16_t> code_point_out>
+void to_utf16(u8range const &range, code_point_out out, conversion_profile &profile)
+{
+    to_utf32(range, to_utf16_iter{out}, profile);
+}
+
+// Engine selection for the bulk conversions: to_utf32(text, out, engines::dfa{}).
+// An engine with a streaming decoder runs it over the whole buffer, others go through the
+// same block kernel as the default.
+// The dfa stream stores into a pointer output's next slot while a sequence is still being read.
+// Valid text gets exactly its code points. On invalid text the slot after the last complete code
+// point may be written before the throw. A buffer of count_code_points(text) slots always has room,
+// as to_u32string allocates.
+template <concepts::contiguous_range_for<char8_t> u8range, ::std::output_iterator<char32_t> code_point_out,
+          concepts::utf8_engine_for<char8_t const *, char8_t const *> engine>
+constexpr void to_utf32(u8range const &range, code_point_out out, engine tag)
+{
+    auto const first = ::std::ranges::data(range);
+    auto const last = first + ::std::ranges::size(range);
+    if (::std::is_constant_evaluated())
+        ::std::ranges::copy(from_utf8_range{first, last, tag}, ::std::move(out));
+    else if constexpr (requires { engine::decode_stream(first, last, out); })
+        (void)engine::decode_stream(first, last, ::std::move(out));
+    else
+        (void)detail::decode_contiguous<engine, false>(first, last, ::std::move(out));
+}
+
+template <concepts::contiguous_range_for<char8_t> u8range, ::std::output_iterator<char16_t> code_point_out,
+          concepts::utf8_engine_for<char8_t const *, char8_t const *> engine>
+constexpr void to_utf16(u8range const &range, code_point_out out, engine tag)
+{
+    to_utf32(range, to_utf16_iter{out}, tag);
+}
+
+// Allocating variants. The result is sized up front and allocated once from the given resource,
+// so a monotonic_buffer_resource bump-allocates the temporaries of a request and frees them en masse.
+// Contiguous input is sized by counting bytes without decoding: there is at most a code point per
+// non-trail byte, plus a surrogate per 4 byte lead. The count is only a bound, overlong forms decode
+// to fewer units, so the result is cut back to what the kernel wrote. Invalid input throws before
+// overrunning it.
+template <concepts::sized_forward_range_for<char8_t> u8range>
+[[nodiscard]] auto to_u32string(u8range const &range,
+                                ::std::pmr::memory_resource *resource = ::std::pmr::get_default_resource())
+    -> ::std::pmr::u32string
+{
+    ::std::pmr::u32string result(resource);
+    if constexpr (concepts::contiguous_range_for<u8range, char8_t>)
+    {
+        result.resize(static_cast<::std::size_t>(count_code_points(range)));
+        auto const first = ::std::ranges::data(range);
+        auto const written = detail::decode_contiguous<engines::branchy, false>(
+            first, first + ::std::ranges::size(range), result.data());
+        result.resize(static_cast<::std::size_t>(written - result.data()));
+    }
+    else
+    {
+        result.resize(static_cast<::std::size_t>(::std::ranges::distance(from_utf8_range{range})));
+        to_utf32(range, result.data());
+    }
+    return result;
+}
+
+template <concepts::sized_forward_range_for<char8_t> u8range>
+[[nodiscard]] auto to_u16string(u8range const &range,
+                                ::std::pmr::memory_resource *resource = ::std::pmr::get_default_resource())
+    -> ::std::pmr::u16string
+{
+    ::std::pmr::u16string result(resource);
+    if constexpr (concepts::contiguous_range_for<u8range, char8_t>)
+    {
+        auto const four_byte_leads = ::std::ranges::count_if(range, [](char8_t byte) { return byte >= 0xF0; });
+        result.resize(static_cast<::std::size_t>(count_code_points(range) + four_byte_leads));
+        auto const first = ::std::ranges::data(range);
+        auto const written = detail::decode_contiguous<engines::branchy, false>(
+            first, first + ::std::ranges::size(range), to_utf16_iter{result.data()});
+        result.resize(static_cast<::std::size_t>(written.base() - result.data()));
+    }
+    else
+    {
+        result.resize(static_cast<::std::size_t>(to_utf16_size(range)));
+        to_utf16(range, result.data());
+    }
+    return result;
+}
+
+// utf32 to utf16. Contiguous input takes the block kernel, at full speed when writing to a char16_t buffer.
+// Code points above U+10FFFF throw, positioned at the code point as a u32beg.
+template <concepts::input_iterator_for<char32_t> u32beg, ::std::sentinel_for<u32beg> u32end,
+          ::std::output_iterator<char16_t> code_point_out>
+constexpr void to_utf16(u32beg beg, u32end end, code_point_out out)
+{
+    if constexpr (::std::contiguous_iterator<u32beg> && ::std::sized_sentinel_for<u32end, u32beg>)
+    {
+        char32_t const *const first = ::std::to_address(beg);
+        detail::caller_positioned(
+            beg, first, [&] { detail::encode_utf16_contiguous(first, first + (end - beg), ::std::move(out)); });
+    }
+    else
+    {
+        detail::tally counts;
+        for (; beg != end; ++beg)
+        {
+            char32_t const code_point = *beg;
+            counts.bytes_in += 4;
+            if (code_point <= 0xFFFF)
+            {
+                *out = static_cast<char16_t>(code_point);
+                ++out;
+                counts.sequence(4, 1);
+            }
+            else if (code_point <= 0x10FFFF)
+            {
+                *out = static_cast<char16_t>(((code_point - 0x10000) >> 10) + 0xD800);
+                ++out;
+                *out = static_cast<char16_t>(((code_point - 0x10000) & 0x3FF) + 0xDC00);
+                ++out;
+                counts.sequence(4, 2);
+            }
+            else
+                detail::fail(beg, error_kind::out_of_utf16_range);
+        }
+    }
+}
+
+template <concepts::sized_input_range_for<char32_t> u32range, ::std::output_iterator<char16_t> code_point_out>
+constexpr void to_utf16(u32range const &range, code_point_out out)
+{
+    to_utf16(::std::ranges::begin(range), ::std::ranges::end(range), out);
+}
+
+template <concepts::contiguous_range_for<char32_t> u32range>
+[[nodiscard]] auto to_u16string(u32range const &range,
+                                ::std::pmr::memory_resource *resource = ::std::pmr::get_default_resource())
+    -> ::std::pmr::u16string
+{
+    ::std::pmr::u16string result(resource);
+    result.resize(static_cast<::std::size_t>(to_utf16_size(range)));
+    to_utf16(range, result.data());
+    return result;
+}
+
+namespace detail
+{
+// Code point readers: read(it, end) returns the code point at it and moves it past it
+
+struct code_point_reader
+{
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto read(src_iter &it, src_end_iter const &) -> char32_t
+    {
+        char32_t const code_point = *it;
+        ++it;
+        return code_point;
+    }
+};
+
+template <class engine>
+struct utf8_reader
+{
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto read(src_iter &it, src_end_iter const &end) -> char32_t
+    {
+        return engine::read(it, end);
+    }
+};
+
+struct utf16_reader
+{
+    template <class src_iter, class src_end_iter>
+    [[nodiscard]] static constexpr auto read(src_iter &it, src_end_iter const &end) -> char32_t
+    {
+        char32_t const unit = *it;
+        if (unit < 0xD800 || 0xDFFF < unit)
+        {
+            ++it;
+            return unit;
+        }
+
+        if (unit > 0xDBFF)
+            detail::fail(it, error_kind::unpaired_low_surrogate);
+
+        auto low = it;
+        ++low;
+        if (low == end || *low < 0xDC00 || 0xDFFF < *low)
+            detail::fail(it, error_kind::unpaired_high_surrogate);
+
+        char32_t const code_point = 0x10000 + ((unit - 0xD800) << 10) + (*low - 0xDC00);
+        it = ++low;
+        return code_point;
+    }
+};
+
+// Encoding a code point one unit at a time
+
+[[nodiscard]] constexpr auto utf8_length(char32_t const code_point) noexcept -> int
+{
+    return code_point < 0x80 ? 1 : code_point < 0x800 ? 2 : code_point < 0x10000 ? 3 : code_point <= 0x10FFFF ? 4 : 0;
+}
+
+[[nodiscard]] constexpr auto utf8_unit(char32_t const code_point, int const length, int const index) noexcept
+    -> char8_t
+{
+    if (length == 1)
+        return static_cast<char8_t>(code_point);
+
+    auto const shift = 6 * (length - 1 - index);
+    if (index == 0)
+        return static_cast<char8_t>(((0xFF00u >> length) & 0xFF) | (code_point >> shift));
+    return static_cast<char8_t>(0x80 | ((code_point >> shift) & 0x3F));
+}
+
+[[nodiscard]] constexpr auto utf16_length(char32_t const code_point) noexcept -> int
+{
+    return code_point <= 0xFFFF ? 1 : code_point <= 0x10FFFF ? 2 : 0;
+}
+
+[[nodiscard]] constexpr auto utf16_unit(char32_t const code_point, int const length, int const index) noexcept
+    -> char16_t
+{
+    if (length == 1)
+        return static_cast<char16_t>(code_point);
+
+    auto const offset = code_point - 0x10000;
+    return static_cast<char16_t>(index == 0 ? (offset >> 10) + 0xD800 : (offset & 0x3FF) + 0xDC00);
+}
+} // namespace detail
+
+// utf16 to code points
+template <concepts::forward_iterator_for<char16_t> src_iter, ::std::sentinel_for<src_iter> src_end_iter>
+class from_utf16_range final : public ::std::ranges::view_interface<from_utf16_range<src_iter, src_end_iter>>
+{
+  private:
+    [[no_unique_address]] src_iter m_begin{};
+    [[no_unique_address]] src_end_iter m_end{};
+
+  public:
+    struct iterator final // forward_iterator
+    {
+      private:
+        friend class from_utf16_range;
+
+        [[no_unique_address]] src_iter m_begin{};
+        [[no_unique_address]] src_end_iter m_end{};
+
+        constexpr iterator(src_iter begin, src_end_iter end) noexcept
+            : m_begin(::std::move(begin))
+            , m_end(::std::move(end))
+        {
+        }
+
+      public:
+        constexpr iterator() = default;
+
+        using iterator_category = ::std::forward_iterator_tag;
+        using difference_type = ::std::ptrdiff_t;
+        using value_type = char32_t;
+
+        // Position of the current code point in the source
+        [[nodiscard]] constexpr auto base() const noexcept -> src_iter const & { return m_begin; }
+
+        [[maybe_unused]] constexpr auto operator++() -> iterator &
+        {
+            (void)detail::utf16_reader::read(m_begin, m_end);
+            return *this;
+        }
+
+        [[nodiscard]] constexpr auto operator++(int) -> iterator
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        [[nodiscard]] constexpr auto operator*() const -> char32_t
+        {
+            auto begin = m_begin;
+            return detail::utf16_reader::read(begin, m_end);
+        }
+
+        [[nodiscard]] constexpr auto operator==(iterator const &other) const noexcept -> bool
+        {
+            return m_begin == other.m_begin;
+        }
+
+        [[nodiscard]] constexpr auto operator==(::std::default_sentinel_t) const noexcept -> bool
+        {
+            return m_begin == m_end;
+        }
+    };
+
+  public:
+    constexpr from_utf16_range() = default;
+
+    constexpr from_utf16_range(src_iter begin, src_end_iter end) noexcept
+        : m_begin(::std::move(begin))
+        , m_end(::std::move(end))
+    {
+    }
+
+    template <concepts::range_for<char16_t> u16range>
+    constexpr from_utf16_range(u16range const &range) noexcept
+        : from_utf16_range(::std::ranges::begin(range), ::std::ranges::end(range))
+    {
+    }
+
+    [[nodiscard]] constexpr auto begin() const noexcept { return iterator(m_begin, m_end); }
+    [[nodiscard]] constexpr auto end() const noexcept
+    {
+        if constexpr (::std::same_as<src_iter, src_end_iter>)
+            return iterator{m_end, m_end};
+        else
+            return ::std::default_sentinel;
+    }
+
+    // The undecoded units
+    [[nodiscard]] constexpr auto source() const noexcept { return ::std::ranges::subrange(m_begin, m_end); }
+};
+
+template <concepts::range_for<char16_t> u16range>
+from_utf16_range(u16range const &range) noexcept
+    ->from_utf16_range<::std::decay_t<decltype(::std::ranges::begin(range))>,
+                       ::std::decay_t<decltype(::std::ranges::end(range))>>;
+
+namespace detail
+{
+// utf16 to utf32 over a contiguous buffer, returns the output past the last code point.
+// Into a char32_t buffer, 8 units at a time: one compare finds whether any is a surrogate,
+// and if none is they are widened with two unpacks. Blocks with surrogates go through the
+// reader, which pairs them and rejects the lone ones; a pair may run past the block.
+template <class code_point_out>
+constexpr auto decode_utf16_contiguous(char16_t const *pos, char16_t const *const last, code_point_out out)
+    -> code_point_out
+{
+    tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos) * 2;
+
+    // one code point, from one unit or a surrogate pair
+    auto const put = [&] {
+        auto const start = pos;
+        *out = utf16_reader::read(pos, last);
+        ++out;
+        counts.sequence(static_cast<::std::uint64_t>(pos - start) * 2, code_point_units<code_point_out>);
+    };
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<code_point_out, char32_t *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            auto const surrogate_bits = _mm_set1_epi16(static_cast<short>(0xF800));
+            auto const surrogate = _mm_set1_epi16(static_cast<short>(0xD800));
+            auto const zero = _mm_setzero_si128();
+
+            while (last - pos >= 8)
+            {
+                auto const units = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                auto const surrogates = _mm_cmpeq_epi16(_mm_and_si128(units, surrogate_bits), surrogate);
+                if (_mm_movemask_epi8(surrogates) == 0)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi16(units, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), _mm_unpackhi_epi16(units, zero));
+                    pos += 8;
+                    out += 8;
+                    counts.block(16, 8);
+                    continue;
+                }
+
+                for (auto const stop = pos + 8; pos < stop;)
+                    put();
+            }
+        }
+    }
+#endif
+
+    while (pos != last)
+        put();
+    return out;
+}
+} // namespace detail
+
+// utf16 to utf32. Contiguous input takes the block kernel, at full speed when writing to a char32_t buffer.
+// Lone surrogates throw, positioned at the surrogate as a u16beg.
+template <concepts::forward_iterator_for<char16_t> u16beg, ::std::sentinel_for<u16beg> u16end,
+          ::std::output_iterator<char32_t> code_point_out>
+constexpr void to_utf32(u16beg beg, u16end end, code_point_out out)
+{
+    if constexpr (::std::contiguous_iterator<u16beg> && ::std::sized_sentinel_for<u16end, u16beg>)
+    {
+        char16_t const *const first = ::std::to_address(beg);
+        detail::caller_positioned(
+            beg, first, [&] { detail::decode_utf16_contiguous(first, first + (end - beg), ::std::move(out)); });
+    }
+    else
+    {
+        detail::tally counts;
+        for (char32_t const code_point : from_utf16_range{beg, end})
+        {
+            *out = code_point;
+            ++out;
+
+            auto const bytes = code_point > 0xFFFF ? 4u : 2u; // a surrogate pair or one unit
+            counts.bytes_in += bytes;
+            counts.sequence(bytes, detail::code_point_units<code_point_out>);
+        }
+    }
+}
+
+template <concepts::sized_forward_range_for<char16_t> u16range, ::std::output_iterator<char32_t> code_point_out>
+constexpr void to_utf32(u16range const &range, code_point_out out)
+{
+    to_utf32(::std::ranges::begin(range), ::std::ranges::end(range), out);
+}
+
+// Sized as a code point per unit that isn't a high surrogate, which is exact for valid input,
+// and cut back to what the kernel wrote
+template <concepts::contiguous_range_for<char16_t> u16range>
+[[nodiscard]] auto to_u32string(u16range const &range,
+                                ::std::pmr::memory_resource *resource = ::std::pmr::get_default_resource())
+    -> ::std::pmr::u32string
+{
+    auto const high_surrogates =
+        ::std::ranges::count_if(range, [](char16_t const unit) { return 0xD800 <= unit && unit <= 0xDBFF; });
+
+    ::std::pmr::u32string result(resource);
+    result.resize(static_cast<::std::size_t>(::std::ranges::ssize(range) - high_surrogates));
+    auto const first = ::std::ranges::data(range);
+    auto const written = detail::decode_utf16_contiguous(first, first + ::std::ranges::size(range), result.data());
+    result.resize(static_cast<::std::size_t>(written - result.data()));
+    return result;
+}
+
+// ISO-8859-1 text, held as char, to and from UTF-8 and UTF-16. Latin-1 is the first 256 code points,
+// so every byte maps to one code point and back; the kernels move 16 ASCII bytes, or 8 to 16 units,
+// per step when writing to a pointer and go a byte or a sequence at a time only where they must.
+namespace latin1
+{
+// UTF-8 bytes the text takes, one more for each byte above 0x7F
+template <concepts::contiguous_range_for<char> latin1_range>
+[[nodiscard]] constexpr auto to_utf8_size(latin1_range const &range) noexcept -> ::std::ptrdiff_t
+{
+    auto const first = ::std::ranges::data(range);
+    auto const size = static_cast<::std::ptrdiff_t>(::std::ranges::size(range));
+    ::std::ptrdiff_t high = 0;
+    for (::std::ptrdiff_t i = 0; i < size; ++i)
+        high += static_cast<unsigned char>(first[i]) >> 7;
+    return size + high;
+}
+
+// Latin-1 bytes a valid UTF-8 text takes, one per code point; doesn't validate
+template <concepts::contiguous_range_for<char8_t> u8range>
+[[nodiscard]] constexpr auto from_utf8_size(u8range const &range) noexcept -> ::std::ptrdiff_t
+{
+    return count_code_points(range);
+}
+
+template <concepts::contiguous_range_for<char> latin1_range, ::std::output_iterator<char8_t> u8_out>
+constexpr void to_utf8(latin1_range const &range, u8_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<u8_out, char8_t *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            for (; last - pos >= 16; pos += 16)
+            {
+                auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                if (_mm_movemask_epi8(bytes) == 0)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+                    out += 16;
+                    counts.block(16, 16);
+                    continue;
+                }
+
+                for (int i = 0; i < 16; ++i)
+                {
+                    auto const byte = static_cast<char8_t>(pos[i]);
+                    if (byte < 0x80)
+                        *out++ = byte;
+                    else
+                    {
+                        *out++ = static_cast<char8_t>(0xC0 | (byte >> 6));
+                        *out++ = static_cast<char8_t>(0x80 | (byte & 0x3F));
+                    }
+                    counts.sequence(1, 1 + (byte >> 7));
+                }
+            }
+        }
+    }
+#endif
+
+    for (; pos != last; ++pos)
+    {
+        auto const byte = static_cast<char8_t>(*pos);
+        if (byte < 0x80)
+        {
+            *out = byte;
+            ++out;
+        }
+        else
+        {
+            *out = static_cast<char8_t>(0xC0 | (byte >> 6));
+            ++out;
+            *out = static_cast<char8_t>(0x80 | (byte & 0x3F));
+            ++out;
+        }
+        counts.sequence(1, 1 + (byte >> 7));
+    }
+}
+
+// Code points above U+FF throw, positioned at their sequence; invalid UTF-8 throws as in to_utf32
+template <concepts::contiguous_range_for<char8_t> u8range, ::std::output_iterator<char> latin1_out>
+constexpr void from_utf8(u8range const &range, latin1_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+
+    // one sequence
+    auto const step = [&] {
+        auto const start = pos;
+        auto const lead = *pos;
+        if (lead < 0x80)
+        {
+            *out = static_cast<char>(lead);
+            ++pos;
+        }
+        else if ((lead == 0xC2 || lead == 0xC3) && last - pos >= 2 && (pos[1] & 0xC0) == 0x80)
+        {
+            *out = static_cast<char>((lead & 0x03) << 6 | (pos[1] & 0x3F));
+            pos += 2;
+        }
+        else
+        {
+            auto const code_point = engines::branchy::read(pos, last);
+            if (code_point > 0xFF)
+                detail::fail(start, error_kind::out_of_latin1_range);
+            *out = static_cast<char>(code_point);
+        }
+        ++out;
+        counts.sequence(static_cast<::std::uint64_t>(pos - start), 1);
+    };
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<latin1_out, char *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            while (last - pos >= 16)
+            {
+                auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                if (_mm_movemask_epi8(bytes) == 0)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+                    pos += 16;
+                    out += 16;
+                    counts.block(16, 16);
+                    continue;
+                }
+
+                for (auto const stop = pos + 16; pos < stop;)
+                    step();
+            }
+        }
+    }
+#endif
+
+    while (pos != last)
+        step();
+}
+
+template <concepts::contiguous_range_for<char> latin1_range, ::std::output_iterator<char16_t> u16_out>
+constexpr void to_utf16(latin1_range const &range, u16_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<u16_out, char16_t *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            auto const zero = _mm_setzero_si128();
+            for (; last - pos >= 16; pos += 16, out += 16)
+            {
+                auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(bytes, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(bytes, zero));
+                counts.block(16, 16);
+            }
+        }
+    }
+#endif
+
+    for (; pos != last; ++pos, ++out)
+    {
+        *out = static_cast<char16_t>(static_cast<unsigned char>(*pos));
+        counts.sequence(1, 1);
+    }
+}
+
+// Units above U+FF throw, positioned at the unit; lone surrogates throw as in to_utf32
+template <concepts::contiguous_range_for<char16_t> u16range, ::std::output_iterator<char> latin1_out>
+constexpr void from_utf16(u16range const &range, latin1_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos) * 2;
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<latin1_out, char *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            auto const high_byte = _mm_set1_epi16(static_cast<short>(0xFF00));
+            auto const zero = _mm_setzero_si128();
+            for (; last - pos >= 8; pos += 8, out += 8)
+            {
+                auto const units = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, high_byte), zero)) != 0xFFFF)
+                    break; // the scalar loop throws at the first one out of range
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(units, units));
+                counts.block(16, 8);
+            }
+        }
+    }
+#endif
+
+    for (; pos != last; ++pos, ++out)
+    {
+        if (*pos > 0xFF)
+        {
+            auto next = pos;
+            (void)detail::utf16_reader::read(next, last); // lone surrogates throw their own error
+            detail::fail(pos, error_kind::out_of_latin1_range);
+        }
+        *out = static_cast<char>(*pos);
+        counts.sequence(2, 1);
+    }
+}
+} // namespace latin1
+
+// Single-byte code pages, text held as char, to and from UTF-8 and UTF-16. Every page here keeps
+// ASCII in its low half, so the kernels move ASCII blocks as latin1 does and look the other bytes
+// up one at a time: a 256-entry table to decode, a two-stage one to encode.
+namespace code_pages
+{
+// Bytes a charset leaves undefined decode to the C1 control of the same value, as the WHATWG
+// Encoding standard has it, so decoding never fails and those bytes round-trip.
+class code_page final
+{
+  private:
+    // Encoding is two lookups: the high byte of the code point picks a row, the low byte the
+    // byte within it. Row 0 is all zeros, which no code point above U+7F encodes to.
+    static constexpr int max_rows = 6;
+
+    // Not constexpr: reaching it stops the constant evaluation, naming the reason in the diagnostic
+    static void too_many_rows_in_code_page() noexcept {}
+
+    ::std::array<char16_t, 256> m_decode{}; // every page is within the BMP
+    ::std::array<unsigned char, 256> m_row_of{};
+    ::std::array<::std::array<unsigned char, 256>, max_rows + 1> m_rows{};
+
+  public:
+    // high: the code points of bytes 0x80 to 0xFF, which have to be distinct and above U+7F;
+    // a page spread over more than max_rows rows doesn't compile
+    consteval explicit code_page(::std::array<char16_t, 128> const &high)
+    {
+        for (int byte = 0; byte < 0x80; ++byte)
+            m_decode[byte] = static_cast<char16_t>(byte);
+
+        int rows = 0;
+        for (int i = 0; i < 128; ++i)
+        {
+            auto const code_point = high[i];
+            m_decode[0x80 + i] = code_point;
+
+            auto &row = m_row_of[code_point >> 8];
+            if (row == 0)
+            {
+                if (++rows > max_rows)
+                    too_many_rows_in_code_page();
+                row = static_cast<unsigned char>(rows);
+            }
+            m_rows[row][code_point & 0xFF] = static_cast<unsigned char>(0x80 + i);
+        }
+    }
+
+    [[nodiscard]] constexpr auto decode(char const byte) const noexcept -> char32_t
+    {
+        return m_decode[static_cast<unsigned char>(byte)];
+    }
+
+    // For std::views::transform
+    [[nodiscard]] constexpr auto operator()(char const byte) const noexcept -> char32_t { return decode(byte); }
+
+    // The byte for code_point, or -1 if the page doesn't have it
+    [[nodiscard]] constexpr auto encode(char32_t const code_point) const noexcept -> int
+    {
+        if (code_point < 0x80)
+            return static_cast<int>(code_point);
+        if (code_point > 0xFFFF)
+            return -1;
+
+        int const byte = m_rows[m_row_of[code_point >> 8]][code_point & 0xFF];
+        return byte != 0 ? byte : -1;
+    }
+};
+
+// Windows-1250, Central European
+inline constexpr code_page windows_1250{{
+    0x20AC, 0x0081, 0x201A, 0x0083, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x0088, 0x2030, 0x0160, 0x2039, 0x015A, 0x0164, 0x017D, 0x0179,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x0098, 0x2122, 0x0161, 0x203A, 0x015B, 0x0165, 0x017E, 0x017A,
+    0x00A0, 0x02C7, 0x02D8, 0x0141, 0x00A4, 0x0104, 0x00A6, 0x00A7,
+    0x00A8, 0x00A9, 0x015E, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x017B,
+    0x00B0, 0x00B1, 0x02DB, 0x0142, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+    0x00B8, 0x0105, 0x015F, 0x00BB, 0x013D, 0x02DD, 0x013E, 0x017C,
+    0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7,
+    0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+    0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7,
+    0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,
+    0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7,
+    0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,
+    0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7,
+    0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9,
+}};
+
+// Windows-1251, Cyrillic
+inline constexpr code_page windows_1251{{
+    0x0402, 0x0403, 0x201A, 0x0453, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x20AC, 0x2030, 0x0409, 0x2039, 0x040A, 0x040C, 0x040B, 0x040F,
+    0x0452, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x0098, 0x2122, 0x0459, 0x203A, 0x045A, 0x045C, 0x045B, 0x045F,
+    0x00A0, 0x040E, 0x045E, 0x0408, 0x00A4, 0x0490, 0x00A6, 0x00A7,
+    0x0401, 0x00A9, 0x0404, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x0407,
+    0x00B0, 0x00B1, 0x0406, 0x0456, 0x0491, 0x00B5, 0x00B6, 0x00B7,
+    0x0451, 0x2116, 0x0454, 0x00BB, 0x0458, 0x0405, 0x0455, 0x0457,
+    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+    0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+    0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+    0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+    0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+}};
+
+// Windows-1252, Western European
+inline constexpr code_page windows_1252{{
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+    0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+    0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+    0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+    0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+}};
+
+// KOI8-R, Russian
+inline constexpr code_page koi8_r{{
+    0x2500, 0x2502, 0x250C, 0x2510, 0x2514, 0x2518, 0x251C, 0x2524,
+    0x252C, 0x2534, 0x253C, 0x2580, 0x2584, 0x2588, 0x258C, 0x2590,
+    0x2591, 0x2592, 0x2593, 0x2320, 0x25A0, 0x2219, 0x221A, 0x2248,
+    0x2264, 0x2265, 0x00A0, 0x2321, 0x00B0, 0x00B2, 0x00B7, 0x00F7,
+    0x2550, 0x2551, 0x2552, 0x0451, 0x2553, 0x2554, 0x2555, 0x2556,
+    0x2557, 0x2558, 0x2559, 0x255A, 0x255B, 0x255C, 0x255D, 0x255E,
+    0x255F, 0x2560, 0x2561, 0x0401, 0x2562, 0x2563, 0x2564, 0x2565,
+    0x2566, 0x2567, 0x2568, 0x2569, 0x256A, 0x256B, 0x256C, 0x00A9,
+    0x044E, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433,
+    0x0445, 0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E,
+    0x043F, 0x044F, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432,
+    0x044C, 0x044B, 0x0437, 0x0448, 0x044D, 0x0449, 0x0447, 0x044A,
+    0x042E, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413,
+    0x0425, 0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E,
+    0x041F, 0x042F, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412,
+    0x042C, 0x042B, 0x0417, 0x0428, 0x042D, 0x0429, 0x0427, 0x042A,
+}};
+
+// KOI8-U, Ukrainian
+inline constexpr code_page koi8_u{{
+    0x2500, 0x2502, 0x250C, 0x2510, 0x2514, 0x2518, 0x251C, 0x2524,
+    0x252C, 0x2534, 0x253C, 0x2580, 0x2584, 0x2588, 0x258C, 0x2590,
+    0x2591, 0x2592, 0x2593, 0x2320, 0x25A0, 0x2219, 0x221A, 0x2248,
+    0x2264, 0x2265, 0x00A0, 0x2321, 0x00B0, 0x00B2, 0x00B7, 0x00F7,
+    0x2550, 0x2551, 0x2552, 0x0451, 0x0454, 0x2554, 0x0456, 0x0457,
+    0x2557, 0x2558, 0x2559, 0x255A, 0x255B, 0x0491, 0x255D, 0x255E,
+    0x255F, 0x2560, 0x2561, 0x0401, 0x0404, 0x2563, 0x0406, 0x0407,
+    0x2566, 0x2567, 0x2568, 0x2569, 0x256A, 0x0490, 0x256C, 0x00A9,
+    0x044E, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433,
+    0x0445, 0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E,
+    0x043F, 0x044F, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432,
+    0x044C, 0x044B, 0x0437, 0x0448, 0x044D, 0x0449, 0x0447, 0x044A,
+    0x042E, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413,
+    0x0425, 0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E,
+    0x041F, 0x042F, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412,
+    0x042C, 0x042B, 0x0417, 0x0428, 0x042D, 0x0429, 0x0427, 0x042A,
+}};
+
+// ISO-8859-2, Central European
+inline constexpr code_page iso_8859_2{{
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,
+    0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x008D, 0x008E, 0x008F,
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,
+    0x0098, 0x0099, 0x009A, 0x009B, 0x009C, 0x009D, 0x009E, 0x009F,
+    0x00A0, 0x0104, 0x02D8, 0x0141, 0x00A4, 0x013D, 0x015A, 0x00A7,
+    0x00A8, 0x0160, 0x015E, 0x0164, 0x0179, 0x00AD, 0x017D, 0x017B,
+    0x00B0, 0x0105, 0x02DB, 0x0142, 0x00B4, 0x013E, 0x015B, 0x02C7,
+    0x00B8, 0x0161, 0x015F, 0x0165, 0x017A, 0x02DD, 0x017E, 0x017C,
+    0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7,
+    0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+    0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7,
+    0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,
+    0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7,
+    0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,
+    0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7,
+    0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9,
+}};
+
+// ISO-8859-5, Cyrillic
+inline constexpr code_page iso_8859_5{{
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,
+    0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x008D, 0x008E, 0x008F,
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,
+    0x0098, 0x0099, 0x009A, 0x009B, 0x009C, 0x009D, 0x009E, 0x009F,
+    0x00A0, 0x0401, 0x0402, 0x0403, 0x0404, 0x0405, 0x0406, 0x0407,
+    0x0408, 0x0409, 0x040A, 0x040B, 0x040C, 0x00AD, 0x040E, 0x040F,
+    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+    0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+    0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+    0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+    0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+    0x2116, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457,
+    0x0458, 0x0459, 0x045A, 0x045B, 0x045C, 0x00A7, 0x045E, 0x045F,
+}};
+
+// ISO-8859-15, Western European with the euro sign
+inline constexpr code_page iso_8859_15{{
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,
+    0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x008D, 0x008E, 0x008F,
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,
+    0x0098, 0x0099, 0x009A, 0x009B, 0x009C, 0x009D, 0x009E, 0x009F,
+    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x20AC, 0x00A5, 0x0160, 0x00A7,
+    0x0161, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x017D, 0x00B5, 0x00B6, 0x00B7,
+    0x017E, 0x00B9, 0x00BA, 0x00BB, 0x0152, 0x0153, 0x0178, 0x00BF,
+    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+    0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+    0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+}};
+
+// UTF-8 bytes the text takes
+template <concepts::contiguous_range_for<char> byte_range>
+[[nodiscard]] constexpr auto to_utf8_size(code_page const &page, byte_range const &range) noexcept
+    -> ::std::ptrdiff_t
+{
+    auto const first = ::std::ranges::data(range);
+    auto const size = static_cast<::std::ptrdiff_t>(::std::ranges::size(range));
+    ::std::ptrdiff_t total = 0;
+    for (::std::ptrdiff_t i = 0; i < size; ++i)
+        total += detail::utf8_length(page.decode(first[i]));
+    return total;
+}
+
+// Bytes a valid UTF-8 text takes, one per code point; doesn't validate
+template <concepts::contiguous_range_for<char8_t> u8range>
+[[nodiscard]] constexpr auto from_utf8_size(u8range const &range) noexcept -> ::std::ptrdiff_t
+{
+    return count_code_points(range);
+}
+
+template <concepts::contiguous_range_for<char> byte_range, ::std::output_iterator<char32_t> u32_out>
+constexpr void to_utf32(code_page const &page, byte_range const &range, u32_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+    for (; pos != last; ++pos, ++out)
+    {
+        *out = page.decode(*pos);
+        counts.sequence(1, 1);
+    }
+}
+
+template <concepts::contiguous_range_for<char> byte_range, ::std::output_iterator<char16_t> u16_out>
+constexpr void to_utf16(code_page const &page, byte_range const &range, u16_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<u16_out, char16_t *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            auto const zero = _mm_setzero_si128();
+            for (; last - pos >= 16; pos += 16, out += 16)
+            {
+                auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                if (_mm_movemask_epi8(bytes) == 0)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(bytes, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(bytes, zero));
+                    counts.block(16, 16);
+                    continue;
+                }
+
+                for (int i = 0; i < 16; ++i)
+                    out[i] = static_cast<char16_t>(page.decode(pos[i]));
+                counts.sequence(16, 16);
+            }
+        }
+    }
+#endif
+
+    for (; pos != last; ++pos, ++out)
+    {
+        *out = static_cast<char16_t>(page.decode(*pos));
+        counts.sequence(1, 1);
+    }
+}
+
+template <concepts::contiguous_range_for<char> byte_range, ::std::output_iterator<char8_t> u8_out>
+constexpr void to_utf8(code_page const &page, byte_range const &range, u8_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+
+    // one byte, which is at most three UTF-8 bytes since pages stay within the BMP
+    auto const step = [&](char const byte) {
+        auto const code_point = page.decode(byte);
+        if (code_point < 0x80)
+        {
+            *out = static_cast<char8_t>(code_point);
+            ++out;
+            counts.sequence(1, 1);
+        }
+        else if (code_point < 0x800)
+        {
+            *out = static_cast<char8_t>(0xC0 | (code_point >> 6));
+            ++out;
+            *out = static_cast<char8_t>(0x80 | (code_point & 0x3F));
+            ++out;
+            counts.sequence(1, 2);
+        }
+        else
+        {
+            *out = static_cast<char8_t>(0xE0 | (code_point >> 12));
+            ++out;
+            *out = static_cast<char8_t>(0x80 | ((code_point >> 6) & 0x3F));
+            ++out;
+            *out = static_cast<char8_t>(0x80 | (code_point & 0x3F));
+            ++out;
+            counts.sequence(1, 3);
+        }
+    };
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<u8_out, char8_t *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            for (; last - pos >= 16; pos += 16)
+            {
+                auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                if (_mm_movemask_epi8(bytes) == 0)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+                    out += 16;
+                    counts.block(16, 16);
+                    continue;
+                }
+
+                for (int i = 0; i < 16; ++i)
+                    step(pos[i]);
+            }
+        }
+    }
+#endif
+
+    for (; pos != last; ++pos)
+        step(*pos);
+}
+
+// Code points the page lacks throw, positioned at their sequence; invalid UTF-8 throws as in to_utf32
+template <concepts::contiguous_range_for<char8_t> u8range, ::std::output_iterator<char> byte_out>
+constexpr void from_utf8(code_page const &page, u8range const &range, byte_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos);
+
+    // one sequence
+    auto const step = [&] {
+        auto const start = pos;
+        if (*pos < 0x80)
+        {
+            *out = static_cast<char>(*pos);
+            ++pos;
+        }
+        else
+        {
+            auto const byte = page.encode(engines::branchy::read(pos, last));
+            if (byte < 0)
+                detail::fail(start, error_kind::not_in_code_page);
+            *out = static_cast<char>(byte);
+        }
+        ++out;
+        counts.sequence(static_cast<::std::uint64_t>(pos - start), 1);
+    };
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<byte_out, char *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            while (last - pos >= 16)
+            {
+                auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                if (_mm_movemask_epi8(bytes) == 0)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+                    pos += 16;
+                    out += 16;
+                    counts.block(16, 16);
+                    continue;
+                }
+
+                for (auto const stop = pos + 16; pos < stop;)
+                    step();
+            }
+        }
+    }
+#endif
+
+    while (pos != last)
+        step();
+}
+
+// Code points the page lacks throw, positioned at their first unit; lone surrogates throw as in to_utf32
+template <concepts::contiguous_range_for<char16_t> u16range, ::std::output_iterator<char> byte_out>
+constexpr void from_utf16(code_page const &page, u16range const &range, byte_out out)
+{
+    auto pos = ::std::ranges::data(range);
+    auto const last = pos + ::std::ranges::size(range);
+
+    detail::tally counts;
+    counts.bytes_in = static_cast<::std::uint64_t>(last - pos) * 2;
+
+    // one code point
+    auto const step = [&] {
+        auto const start = pos;
+        auto const byte = page.encode(detail::utf16_reader::read(pos, last));
+        if (byte < 0)
+            detail::fail(start, error_kind::not_in_code_page);
+        *out = static_cast<char>(byte);
+        ++out;
+        counts.sequence(static_cast<::std::uint64_t>(pos - start) * 2, 1);
+    };
+
+#if UNIC_SSE2
+    if constexpr (::std::is_same_v<byte_out, char *>)
+    {
+        if (!::std::is_constant_evaluated())
+        {
+            auto const non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+            auto const zero = _mm_setzero_si128();
+            while (last - pos >= 8)
+            {
+                auto const units = _mm_loadu_si128(reinterpret_cast<__m128i const *>(pos));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, non_ascii), zero)) == 0xFFFF)
+                {
+                    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(units, units));
+                    pos += 8;
+                    out += 8;
+                    counts.block(16, 8);
+                    continue;
+                }
+
+                // a pair straddling the block end is read whole and may run one unit past stop
+                for (auto const stop = pos + 8; pos < stop;)
+                    step();
+            }
+        }
+    }
+#endif
+
+    while (pos != last)
+        step();
+}
+} // namespace code_pages
+
+// Code points to UTF-8 (char8_t) or UTF-16 (char16_t) units, as a view.
+// reader pulls one code point at a time out of base: plain char32_t ranges use
+// detail::code_point_reader, the views::encode_* adaptors plug a decoder in directly
+// when stacked on a decoding view, so transcoding takes a single pass over the source.
+template <class reader, ::std::ranges::view V, class out_unit>
+    requires ::std::ranges::forward_range<V const> &&
+             (::std::same_as<out_unit, char8_t> || ::std::same_as<out_unit, char16_t>)
+class encode_view final : public ::std::ranges::view_interface<encode_view<reader, V, out_unit>>
+{
+  private:
+    using src_iter = ::std::ranges::iterator_t<V const>;
+    using src_end_iter = ::std::ranges::sentinel_t<V const>;
+
+    [[no_unique_address]] V m_base{};
+
+    [[nodiscard]] static constexpr auto length(char32_t const code_point) noexcept -> int
+    {
+        if constexpr (::std::same_as<out_unit, char8_t>)
+            return detail::utf8_length(code_point);
+        else
+            return detail::utf16_length(code_point);
+    }
+
+  public:
+    struct iterator final // forward_iterator
+    {
+      private:
+        friend class encode_view;
+
+        [[no_unique_address]] src_iter m_current{}; // the code point being encoded
+        [[no_unique_address]] src_iter m_next{};    // and the one after it
+        [[no_unique_address]] src_end_iter m_end{};
+        char32_t m_code_point = 0;
+        ::std::int8_t m_length = 0; // units of m_code_point, 0 at the end
+        ::std::int8_t m_index = 0;
+
+        constexpr iterator(src_iter begin, src_end_iter end)
+            : m_next(::std::move(begin))
+            , m_end(::std::move(end))
+        {
+            load();
+        }
+
+        constexpr void load()
+        {
+            m_current = m_next;
+            m_index = 0;
+            if (m_next == m_end)
+            {
+                m_length = 0;
+                return;
+            }
+
+            m_code_point = reader::read(m_next, m_end);
+            m_length = static_cast<::std::int8_t>(length(m_code_point));
+            if (m_length == 0)
+                detail::fail(m_current, error_kind::out_of_unicode_range);
+        }
+
+      public:
+        constexpr iterator() = default;
+
+        using iterator_category = ::std::forward_iterator_tag;
+        using difference_type = ::std::ptrdiff_t;
+        using value_type = out_unit;
+
+        // Position of the code point being encoded in the source
+        [[nodiscard]] constexpr auto base() const noexcept -> src_iter const & { return m_current; }
+
+        [[maybe_unused]] constexpr auto operator++() -> iterator &
+        {
+            if (++m_index == m_length)
+                load();
+            return *this;
+        }
+
+        [[nodiscard]] constexpr auto operator++(int) -> iterator
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        [[nodiscard]] constexpr auto operator*() const noexcept -> out_unit
+        {
+            if constexpr (::std::same_as<out_unit, char8_t>)
+                return detail::utf8_unit(m_code_point, m_length, m_index);
+            else
+                return detail::utf16_unit(m_code_point, m_length, m_index);
+        }
+
+        [[nodiscard]] constexpr auto operator==(iterator const &other) const noexcept -> bool
+        {
+            return m_current == other.m_current && m_index == other.m_index;
+        }
+
+        [[nodiscard]] constexpr auto operator==(::std::default_sentinel_t) const noexcept -> bool
+        {
+            return m_length == 0;
+        }
+    };
+
+    constexpr encode_view() = default;
+
+    constexpr explicit encode_view(V base) noexcept(::std::is_nothrow_move_constructible_v<V>)
+        : m_base(::std::move(base))
+    {
+    }
+
+    [[nodiscard]] constexpr auto begin() const
+    {
+        return iterator(::std::ranges::begin(m_base), ::std::ranges::end(m_base));
+    }
+
+    [[nodiscard]] constexpr auto end() const noexcept { return ::std::default_sentinel; }
+};
+
+namespace views
+{
+namespace detail
+{
+template <class>
+inline constexpr bool is_from_utf8_range = false;
+
+template <class src_iter, class src_end_iter, class engine>
+inline constexpr bool is_from_utf8_range<from_utf8_range<src_iter, src_end_iter, engine>> = true;
+
+template <class>
+inline constexpr bool is_from_utf16_range = false;
+
+template <class src_iter, class src_end_iter>
+inline constexpr bool is_from_utf16_range<from_utf16_range<src_iter, src_end_iter>> = true;
+
+// Lets an adaptor be applied with |
+template <class Fn>
+struct closure : Fn
+{
+    template <::std::ranges::viewable_range R>
+        requires ::std::invocable<Fn const &, R>
+    [[nodiscard]] friend constexpr auto operator|(R &&range, closure const &self)
+    {
+        return self(::std::forward<R>(range));
+    }
+};
+
+template <class Fn>
+closure(Fn) -> closure<Fn>;
+
+template <class out_unit>
+struct encode_fn
+{
+    template <::std::ranges::viewable_range R>
+        requires concepts::range_for<R, char32_t>
+    [[nodiscard]] constexpr auto operator()(R &&range) const
+    {
+        using range_type = ::std::remove_cvref_t<R>;
+        if constexpr (is_from_utf8_range<range_type>)
+        {
+            using reader = ::unic::detail::utf8_reader<typename range_type::engine_type>;
+            return encode_view<reader, decltype(range.source()), out_unit>{range.source()};
+        }
+        else if constexpr (is_from_utf16_range<range_type>)
+            return encode_view<::unic::detail::utf16_reader, decltype(range.source()), out_unit>{range.source()};
+        else
+        {
+            return encode_view<::unic::detail::code_point_reader, ::std::views::all_t<R>, out_unit>{
+                ::std::views::all(::std::forward<R>(range))};
+        }
+    }
+};
+
+struct decode_utf8_fn
+{
+    // The decoded view only holds iterators, so the source has to outlive it
+    template <::std::ranges::borrowed_range R>
+        requires concepts::sized_forward_range_for<R, char8_t>
+    [[nodiscard]] constexpr auto operator()(R &&range) const
+    {
+        return from_utf8_range{range};
+    }
+
+    template <::std::ranges::borrowed_range R, class engine>
+        requires concepts::sized_forward_range_for<R, char8_t>
+    [[nodiscard]] constexpr auto operator()(R &&range, engine tag) const
+    {
+        return from_utf8_range{range, tag};
+    }
+
+    // Engine selection: text | views::decode_utf8(engines::dfa{})
+    template <class engine>
+        requires(!::std::ranges::range<engine>)
+    [[nodiscard]] constexpr auto operator()(engine tag) const
+    {
+        return closure{[tag]<class R>(R &&range) requires ::std::invocable<decode_utf8_fn const &, R, engine> {
+            return decode_utf8_fn{}(::std::forward<R>(range), tag);
+        }};
+    }
+};
+
+struct decode_utf16_fn
+{
+    template <::std::ranges::borrowed_range R>
+        requires concepts::range_for<R, char16_t> && ::std::ranges::forward_range<R>
+    [[nodiscard]] constexpr auto operator()(R &&range) const
+    {
+        return from_utf16_range{range};
+    }
+};
+
+struct decode_code_page_fn
+{
+    // The view holds a pointer to the page, which the predefined pages outlive
+    template <::std::ranges::viewable_range R>
+        requires concepts::range_for<R, char>
+    [[nodiscard]] constexpr auto operator()(R &&range, code_pages::code_page const &page) const
+    {
+        return ::std::views::transform(::std::forward<R>(range),
+                                       [table = &page](char const byte) { return table->decode(byte); });
+    }
+
+    // text | views::decode_code_page(code_pages::koi8_r)
+    [[nodiscard]] constexpr auto operator()(code_pages::code_page const &page) const
+    {
+        return closure{[table = &page]<class R>(R &&range)
+                           requires ::std::invocable<decode_code_page_fn const &, R, code_pages::code_page const &>
+                       { return decode_code_page_fn{}(::std::forward<R>(range), *table); }};
+    }
+};
+} // namespace detail
+
+// Range adaptors: text | views::decode_utf8 | views::encode_utf16
+// Decoding views borrow the source, which must therefore be an lvalue or a borrowed range.
+// An encoder stacked right on a decoder reads the source units itself instead of going
+// through the decoding view's iterator.
+inline constexpr detail::closure<detail::decode_utf8_fn> decode_utf8{};
+inline constexpr detail::closure<detail::decode_utf16_fn> decode_utf16{};
+inline constexpr detail::closure<detail::encode_fn<char8_t>> encode_utf8{};
+inline constexpr detail::closure<detail::encode_fn<char16_t>> encode_utf16{};
+// Single-byte text to code points: bytes | views::decode_code_page(code_pages::windows_1251)
+inline constexpr detail::decode_code_page_fn decode_code_page{};
+} // namespace views
+
+// String literal usable as a template argument: u16_literal<u8"...">
+template <::std::size_t N>
+struct u8_fixed_string
+{
+    char8_t chars[N]{};
+
+    consteval u8_fixed_string(char8_t const (&str)[N]) noexcept { ::std::copy_n(str, N, chars); }
+
+    [[nodiscard]] constexpr auto view() const noexcept -> ::std::u8string_view { return {chars, N - 1}; }
+};
+
+namespace detail
+{
+// Decodes strictly, so a malformed literal is a compile error
+template <u8_fixed_string str>
+[[nodiscard]] consteval auto transcode_u16_literal()
+{
+    constexpr auto size = to_utf16_size(from_utf8_range{str.view(), engines::dfa{}});
+
+    ::std::array<char16_t, size + 1> result{}; // keeps a null terminator
+    ::std::ranges::copy(from_utf8_range{str.view(), engines::dfa{}}, to_utf16_iter{result.data()});
+    return result;
+}
+} // namespace detail
+
+// UTF-16 copy of a UTF-8 literal, transcoded at compile time into static storage
+template <u8_fixed_string str>
+inline constexpr auto u16_literal_storage = detail::transcode_u16_literal<str>();
+
+template <u8_fixed_string str>
+inline constexpr ::std::u16string_view u16_literal{u16_literal_storage<str>.data(),
+                                                   u16_literal_storage<str>.size() - 1};
+
+} // namespace unic
+
+// The views below hold iterators only, not the range they come from
+namespace std::ranges
+{
+template <class src_iter, class src_end_iter, class engine>
+inline constexpr bool enable_borrowed_range<::unic::from_utf8_range<src_iter, src_end_iter, engine>> = true;
+
+template <class src_iter, class src_end_iter>
+inline constexpr bool enable_borrowed_range<::unic::from_utf16_range<src_iter, src_end_iter>> = true;
+
+template <class reader, class V, class out_unit>
+inline constexpr bool enable_borrowed_range<::unic::encode_view<reader, V, out_unit>> = enable_borrowed_range<V>;
+} // namespace std::ranges
@@ -0,0 +1,278 @@
+#pragma once
+
+// unic::transcode_cache, apart from unic.h so that only its users pull in the threading headers
+
+#include "unic.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace unic
+{
+namespace detail
+{
+// Word at a time hash of a byte string, for keying caches rather than for resisting attacks
+[[nodiscard]] inline auto hash_bytes(::std::u8string_view const bytes) noexcept -> ::std::uint64_t
+{
+    constexpr ::std::uint64_t multiplier = 0x9E3779B97F4A7C15u;
+
+    auto pos = bytes.data();
+    auto const last = pos + bytes.size();
+    auto hash = bytes.size() * multiplier;
+    auto const mix = [&](::std::uint64_t const word) {
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    };
+
+    for (; last - pos >= 8; pos += 8)
+        mix(load_word(pos));
+    if (pos != last)
+    {
+        ::std::uint64_t tail = 0;
+        ::std::memcpy(&tail, pos, static_cast<::std::size_t>(last - pos));
+        mix(tail);
+    }
+    return hash ^ (hash >> 32);
+}
+} // namespace detail
+
+// Memoised utf8 to utf16 conversions of a recurring set of strings, such as identifiers.
+// Safe to share between threads: the entries are split over independently locked shards.
+// Memory is bounded by a byte budget, split evenly over the shards and enforced per shard with
+// CLOCK eviction, so an entry read since the hand last passed it gets a second chance.
+// An entry costs entry_overhead bytes plus the heap blocks its key and value hold, their capacity
+// and terminator; a string too big for a shard is converted but not cached. The allocator's and the
+// index's own bookkeeping is not charged, so the budget bounds the entries rather than every byte.
+// Lookups return a handle that pins the converted string; its view stays valid while the
+// handle lives, even if the entry is evicted meanwhile.
+class transcode_cache final
+{
+  public:
+    struct entry
+    {
+        ::std::u8string key;
+        ::std::pmr::u16string value;
+    };
+
+    class handle final
+    {
+      private:
+        friend class transcode_cache;
+
+        ::std::shared_ptr<entry const> m_entry;
+
+        explicit handle(::std::shared_ptr<entry const> entry) noexcept
+            : m_entry(::std::move(entry))
+        {
+        }
+
+      public:
+        [[nodiscard]] auto view() const noexcept -> ::std::u16string_view { return m_entry->value; }
+        [[nodiscard]] operator ::std::u16string_view() const noexcept { return view(); }
+    };
+
+    struct statistics
+    {
+        ::std::uint64_t hits = 0;
+        ::std::uint64_t misses = 0;
+        ::std::uint64_t evictions = 0;
+    };
+
+  private:
+    static constexpr ::std::size_t shard_count = 16;
+
+    struct slot
+    {
+        ::std::shared_ptr<entry const> value;
+        ::std::uint64_t hash = 0;
+        ::std::size_t cost = 0;
+        bool referenced = false;
+    };
+
+    struct shard
+    {
+        ::std::mutex mutex;
+        ::std::unordered_multimap<::std::uint64_t, ::std::size_t> index; // hash to slot
+        ::std::vector<slot> slots;
+        ::std::vector<::std::size_t> free_slots;
+        ::std::size_t hand = 0;
+        ::std::size_t used = 0;
+    };
+
+  public:
+    // Bytes an entry costs besides its key and its value
+    static constexpr ::std::size_t entry_overhead = sizeof(entry) + sizeof(slot);
+
+    // Smallest budget whose shards can each hold an entry
+    static constexpr ::std::size_t min_budget = shard_count * entry_overhead;
+
+  private:
+    ::std::size_t m_shard_budget;
+    ::std::array<shard, shard_count> m_shards;
+
+    ::std::atomic<::std::uint64_t> m_hits = 0;
+    ::std::atomic<::std::uint64_t> m_misses = 0;
+    ::std::atomic<::std::uint64_t> m_evictions = 0;
+
+    // Bytes a string holds on the heap: none while it is stored inside the object, which
+    // entry_overhead counts, else its capacity and terminator
+    template <class string>
+    [[nodiscard]] static auto heap_bytes(string const &str) noexcept -> ::std::size_t
+    {
+        auto const data = reinterpret_cast<char const *>(str.data());
+        auto const object = reinterpret_cast<char const *>(&str);
+        if (!::std::less<>{}(data, object) && ::std::less<>{}(data, object + sizeof str))
+            return 0;
+        return (str.capacity() + 1) * sizeof(typename string::value_type);
+    }
+
+    // Bytes charged for an entry, including the bookkeeping around it
+    [[nodiscard]] static auto cost_of(entry const &e) noexcept -> ::std::size_t
+    {
+        return entry_overhead + heap_bytes(e.key) + heap_bytes(e.value);
+    }
+
+    [[nodiscard]] static auto find(shard &s, ::std::uint64_t const hash, ::std::u8string_view const key) -> slot *
+    {
+        auto [first, last] = s.index.equal_range(hash);
+        for (; first != last; ++first)
+        {
+            auto &candidate = s.slots[first->second];
+            if (candidate.value->key == key)
+                return &candidate;
+        }
+        return nullptr;
+    }
+
+    void evict_one(shard &s)
+    {
+        for (;;)
+        {
+            if (s.hand >= s.slots.size())
+                s.hand = 0;
+            auto &victim = s.slots[s.hand];
+            auto const position = s.hand++;
+
+            if (!victim.value)
+                continue;
+            if (::std::exchange(victim.referenced, false))
+                continue;
+
+            auto [first, last] = s.index.equal_range(victim.hash);
+            for (; first != last; ++first)
+            {
+                if (first->second == position)
+                {
+                    s.index.erase(first);
+                    break;
+                }
+            }
+            s.used -= victim.cost;
+            victim = slot{};
+            s.free_slots.push_back(position);
+            m_evictions.fetch_add(1, ::std::memory_order_relaxed);
+            return;
+        }
+    }
+
+  public:
+    // A budget below min_budget couldn't cache anything and is rejected: std::invalid_argument is
+    // thrown, or without exceptions std::abort called
+    explicit transcode_cache(::std::size_t const budget_bytes)
+        : m_shard_budget(budget_bytes / shard_count)
+    {
+        if (budget_bytes < min_budget)
+        {
+#if UNIC_EXCEPTIONS
+            throw ::std::invalid_argument("transcode_cache budget is below min_budget");
+#else
+            ::std::abort();
+#endif
+        }
+    }
+
+    transcode_cache(transcode_cache const &) = delete;
+    auto operator=(transcode_cache const &) -> transcode_cache & = delete;
+
+    // Throws like to_utf16 on invalid input, without caching anything
+    [[nodiscard]] auto get(::std::u8string_view const key) -> handle
+    {
+        auto const hash = detail::hash_bytes(key);
+        auto &s = m_shards[hash % shard_count];
+
+        {
+            ::std::lock_guard const lock(s.mutex);
+            if (auto const hit = find(s, hash, key))
+            {
+                hit->referenced = true;
+                m_hits.fetch_add(1, ::std::memory_order_relaxed);
+                return handle{hit->value};
+            }
+        }
+
+        // Convert outside the lock, another thread may race us to the same key
+        m_misses.fetch_add(1, ::std::memory_order_relaxed);
+        auto converted = ::std::make_shared<entry const>(entry{::std::u8string(key), to_u16string(key)});
+        auto const cost = cost_of(*converted);
+        if (cost > m_shard_budget)
+            return handle{::std::move(converted)};
+
+        ::std::lock_guard const lock(s.mutex);
+        if (auto const raced = find(s, hash, key))
+            return handle{raced->value};
+
+        while (s.used + cost > m_shard_budget)
+            evict_one(s);
+
+        ::std::size_t position;
+        if (s.free_slots.empty())
+        {
+            position = s.slots.size();
+            s.slots.emplace_back();
+        }
+        else
+        {
+            position = s.free_slots.back();
+            s.free_slots.pop_back();
+        }
+
+        s.slots[position] = slot{converted, hash, cost, false};
+        s.index.emplace(hash, position);
+        s.used += cost;
+        return handle{::std::move(converted)};
+    }
+
+    [[nodiscard]] auto stats() const noexcept -> statistics
+    {
+        return {m_hits.load(::std::memory_order_relaxed), m_misses.load(::std::memory_order_relaxed),
+                m_evictions.load(::std::memory_order_relaxed)};
+    }
+
+    void clear()
+    {
+        for (auto &s : m_shards)
+        {
+            ::std::lock_guard const lock(s.mutex);
+            s.index.clear();
+            s.slots.clear();
+            s.free_slots.clear();
+            s.hand = 0;
+            s.used = 0;
+        }
+    }
+};
+} // namespace unic